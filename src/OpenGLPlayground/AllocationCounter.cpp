@@ -0,0 +1,83 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// The replacements of the global operator new and delete, which count every allocation before passing it on to malloc.
+// Replacing them is only allowed once per program, which is why they live in a source file of their own.
+// The counters are zero initialized before any constructor runs, so allocations made during static initialization are counted too.
+static std::atomic<long long> allocationCount(0);
+static std::atomic<long long> allocationBytes(0);
+
+long long AllocationCounter::allocations()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+long long AllocationCounter::allocatedBytes()
+{
+	return allocationBytes.load(std::memory_order_relaxed);
+}
+
+static void* countedAllocate(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocationBytes.fetch_add((long long)size, std::memory_order_relaxed);
+
+	// malloc(0) may return NULL, but new has to return a unique pointer.
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+	void* memory = countedAllocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
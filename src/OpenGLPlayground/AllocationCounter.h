@@ -0,0 +1,18 @@
+#pragma once
+
+// Counts the heap allocations of the whole program, on every thread.
+// AllocationCounter.cpp replaces the global operator new and delete, so every new, std::vector growth, std::string and
+// std::function that goes to the heap is counted. Memory the C libraries and the OpenGL driver get with malloc isn't.
+// Take the counts before and after a piece of code to see whether it allocated:
+//	long long before = AllocationCounter::allocations();
+//	...
+//	long long allocated = AllocationCounter::allocations() - before;
+class AllocationCounter
+{
+public:
+	// Number of allocations made since the program started.
+	static long long allocations();
+
+	// Number of bytes requested by those allocations.
+	static long long allocatedBytes();
+};
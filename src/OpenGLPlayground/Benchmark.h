@@ -0,0 +1,384 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A deterministic camera path used instead of keyboard/mouse input while benchmarking.
+// Scripts are evaluated at a fixed timestep (frame index / 60), so every run renders exactly the same frames
+// no matter how fast the machine is.
+struct CameraPose
+{
+	glm::vec3 Position;
+	glm::vec3 Front;
+	float FOV;
+};
+
+class CameraScript
+{
+public:
+	std::string Name;
+
+	// Fixed timestep the scripts are evaluated with.
+	static constexpr float TimeStep = 1.0f / 60.0f;
+
+	CameraScript(const std::string& name = "orbit") : Name(name)
+	{
+	}
+
+	// Names of the built-in scripts:
+	//	- static:		the default camera of the interactive mode, not moving at all.
+	//	- orbit:		circles around the center of the cube field, always looking at it.
+	//	- flythrough:	flies straight through the cube field and back while sweeping the view left and right.
+	static bool exists(const std::string& name)
+	{
+		return name == "static" || name == "orbit" || name == "flythrough";
+	}
+
+	CameraPose evaluate(int frame) const
+	{
+		float t = frame * TimeStep;
+		CameraPose pose;
+		pose.FOV = 45.0f;
+
+		if (Name == "orbit")
+		{
+			const glm::vec3 center(0.0f, 0.0f, -6.0f);
+			float angle = t * 0.5f;
+			pose.Position = center + glm::vec3(sin(angle) * 10.0f, 2.0f + sin(t * 0.3f), cos(angle) * 10.0f);
+			pose.Front = glm::normalize(center - pose.Position);
+		}
+		else if (Name == "flythrough")
+		{
+			// Ping-pong between z = 3 and z = -18 every 10 seconds.
+			float phase = fmod(t, 20.0f) / 10.0f;
+			float z = 3.0f - 21.0f * (phase < 1.0f ? phase : 2.0f - phase);
+			float yaw = glm::radians(-90.0f + 30.0f * sin(t));
+			pose.Position = glm::vec3(0.0f, 0.5f, z);
+			pose.Front = glm::normalize(glm::vec3(cos(yaw), -0.05f, sin(yaw)));
+			if (phase >= 1.0f)
+				pose.Front.z = -pose.Front.z;
+			pose.FOV = 60.0f;
+		}
+		else
+		{
+			pose.Position = glm::vec3(0.0f, 0.0f, 3.0f);
+			pose.Front = glm::vec3(0.0f, 0.0f, -1.0f);
+		}
+
+		return pose;
+	}
+};
+
+// Summary of a series of per-frame measurements, in milliseconds.
+struct FrameStatistics
+{
+	float Mean, P50, P95, P99, Max;
+
+	static FrameStatistics compute(std::vector<float> samples)
+	{
+		FrameStatistics stats = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		if (samples.empty())
+			return stats;
+
+		std::sort(samples.begin(), samples.end());
+		double total = 0.0;
+		for (size_t i = 0; i < samples.size(); i++)
+			total += samples[i];
+
+		stats.Mean = (float)(total / samples.size());
+		stats.P50 = percentile(samples, 0.50f);
+		stats.P95 = percentile(samples, 0.95f);
+		stats.P99 = percentile(samples, 0.99f);
+		stats.Max = samples.back();
+		return stats;
+	}
+
+private:
+	// Nearest-rank percentile of already sorted samples.
+	static float percentile(const std::vector<float>& sorted, float p)
+	{
+		size_t rank = (size_t)std::ceil(p * sorted.size());
+		return sorted[rank == 0 ? 0 : rank - 1];
+	}
+};
+
+// Records CPU and GPU time of every frame.
+// GPU time is measured with GL_TIME_ELAPSED queries. Reading a query result right after the frame would stall
+// the CPU until the GPU caught up, so the queries are kept in a small ring and read back a few frames later.
+class BenchmarkRecorder
+{
+public:
+	// Frames rendered before recording starts, to let caches, the driver and the GPU clocks settle.
+	int WarmupFrames;
+
+	// Whether GPU time is measured. Without an OpenGL context (the software rasterizer), only CPU and frame times are recorded.
+	bool MeasureGpu;
+
+	// Name of the renderer, written to the report.
+	std::string Renderer;
+
+	// Per-frame measurements in milliseconds:
+	//	- FrameTimes:	wall clock time of the whole frame, including the swap/finish at its end.
+	//	- CpuTimes:		time the CPU spent on the frame before presenting it.
+	//	- GpuTimes:		time the GPU spent executing the frame's commands.
+	std::vector<float> FrameTimes;
+	std::vector<float> CpuTimes;
+	std::vector<float> GpuTimes;
+
+	// Totals over the recorded frames: draw calls issued, and objects that passed or failed frustum culling.
+	long long DrawCalls;
+	long long VisibleObjects;
+	long long CulledObjects;
+
+	// Totals of the GL state changes passed on to OpenGL and skipped as redundant by the render state cache.
+	long long StateChangesIssued;
+	long long StateChangesSkipped;
+
+	// Totals of the data streamed to the GPU through stream buffers: bytes written, and stalls waiting for the GPU
+	// to release a region (with the time spent waiting in milliseconds).
+	long long StreamedBytes;
+	long long StreamStalls;
+	double StreamStallTime;
+
+	// Totals of the heap allocations made during the recorded frames (on any thread), and the bytes they requested.
+	// Once warmed up, a frame shouldn't allocate at all: everything it needs is either kept from the last frame or comes from a frame arena.
+	long long Allocations;
+	long long AllocatedBytes;
+
+	BenchmarkRecorder(int warmupFrames = 0, bool measureGpu = true) : WarmupFrames(warmupFrames), MeasureGpu(measureGpu), DrawCalls(0),
+		VisibleObjects(0), CulledObjects(0), StateChangesIssued(0), StateChangesSkipped(0),
+		StreamedBytes(0), StreamStalls(0), StreamStallTime(0.0), Allocations(0), AllocatedBytes(0), frame(0),
+		allocationsStart(0), allocatedBytesStart(0)
+	{
+		std::fill(queries, queries + QueryCount, 0u);
+	}
+
+	// Make room for the timings of a run of frameCount frames up front, so recording them doesn't allocate during the run.
+	void reserve(int frameCount)
+	{
+		size_t recorded = (size_t)std::max(0, frameCount - WarmupFrames);
+		FrameTimes.reserve(recorded);
+		CpuTimes.reserve(recorded);
+		GpuTimes.reserve(recorded);
+	}
+
+	void beginFrame()
+	{
+		allocationsStart = AllocationCounter::allocations();
+		allocatedBytesStart = AllocationCounter::allocatedBytes();
+		frameStart = std::chrono::steady_clock::now();
+		if (!MeasureGpu)
+			return;
+
+		// The queries are only created once recording starts, as the recorder may be constructed for an interactive session too.
+		if (queries[0] == 0)
+			glGenQueries(QueryCount, queries);
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame % QueryCount]);
+	}
+
+	// Count draw calls issued during the current frame.
+	void countDrawCalls(int count)
+	{
+		if (frame >= WarmupFrames)
+			DrawCalls += count;
+	}
+
+	// Count the results of frustum culling during the current frame.
+	void countCulling(size_t visible, size_t culled)
+	{
+		if (frame >= WarmupFrames)
+		{
+			VisibleObjects += visible;
+			CulledObjects += culled;
+		}
+	}
+
+	// Count the state changes made during the current frame.
+	void countStateChanges(int issued, int skipped)
+	{
+		if (frame >= WarmupFrames)
+		{
+			StateChangesIssued += issued;
+			StateChangesSkipped += skipped;
+		}
+	}
+
+	// Count the data streamed during the current frame.
+	void countStreaming(long long bytes, int stalls, double stallTime)
+	{
+		if (frame >= WarmupFrames)
+		{
+			StreamedBytes += bytes;
+			StreamStalls += stalls;
+			StreamStallTime += stallTime;
+		}
+	}
+
+	// Mark the end of the frame's CPU work, right before the frame is presented.
+	void endCpuWork()
+	{
+		if (MeasureGpu)
+			glEndQuery(GL_TIME_ELAPSED);
+		cpuEnd = std::chrono::steady_clock::now();
+	}
+
+	// Mark the end of the frame, after it has been presented.
+	void endFrame()
+	{
+		std::chrono::steady_clock::time_point frameEnd = std::chrono::steady_clock::now();
+		if (frame >= WarmupFrames)
+		{
+			FrameTimes.push_back(std::chrono::duration<float, std::milli>(frameEnd - frameStart).count());
+			CpuTimes.push_back(std::chrono::duration<float, std::milli>(cpuEnd - frameStart).count());
+			Allocations += AllocationCounter::allocations() - allocationsStart;
+			AllocatedBytes += AllocationCounter::allocatedBytes() - allocatedBytesStart;
+		}
+
+		// Collect the oldest query once the ring is full, it has most likely finished by now.
+		frame++;
+		if (MeasureGpu && frame >= QueryCount)
+			collectQuery(frame - QueryCount);
+	}
+
+	// Collect the results of the queries still in flight and release them. Call once after the last frame.
+	void finish()
+	{
+		if (queries[0] == 0)
+			return;
+
+		for (int i = std::max(0, frame - QueryCount + 1); i < frame; i++)
+			collectQuery(i);
+
+		glDeleteQueries(QueryCount, queries);
+		std::fill(queries, queries + QueryCount, 0u);
+	}
+
+	// Whether the recorded frames got by without a single heap allocation. Prints an error if they didn't.
+	bool checkAllocations() const
+	{
+		if (Allocations == 0)
+			return true;
+
+		std::cout << "ERROR::BENCHMARK::FRAMES_ALLOCATED " << Allocations << " heap allocations in " << FrameTimes.size()
+			<< " frames after the warmup" << std::endl;
+		return false;
+	}
+
+	void printSummary(std::ostream& out) const
+	{
+		out << "Benchmark: " << FrameTimes.size() << " frames (" << WarmupFrames << " warmup frames excluded), "
+			<< drawCallsPerFrame() << " draw calls per frame" << std::endl;
+		if (StateChangesIssued + StateChangesSkipped > 0)
+			out << "  state changes: " << perFrame(StateChangesIssued) << " issued, " << perFrame(StateChangesSkipped) << " skipped per frame" << std::endl;
+		if (StreamedBytes > 0)
+			out << "  streaming: " << perFrame(StreamedBytes) / 1024.0 << " KB per frame, " << StreamStalls << " stalls ("
+				<< StreamStallTime << " ms waiting)" << std::endl;
+		if (VisibleObjects + CulledObjects > 0)
+			out << "  culling: " << perFrame(VisibleObjects) << " visible, " << perFrame(CulledObjects) << " culled objects per frame" << std::endl;
+		out << "  heap: " << perFrame(Allocations) << " allocations (" << perFrame(AllocatedBytes) << " bytes) per frame" << std::endl;
+		printStatistics(out, "frame", FrameStatistics::compute(FrameTimes));
+		printStatistics(out, "cpu  ", FrameStatistics::compute(CpuTimes));
+		if (MeasureGpu)
+			printStatistics(out, "gpu  ", FrameStatistics::compute(GpuTimes));
+	}
+
+	// Write the report to a file. A path ending with .json writes the summary and all samples as JSON,
+	// anything else writes one CSV row per frame.
+	bool writeReport(const std::string& path, const std::string& scriptName) const
+	{
+		std::ofstream file(path.c_str());
+		if (!file)
+		{
+			std::cout << "ERROR::BENCHMARK::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+
+		bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+		if (json)
+		{
+			file << "{\n";
+			file << "  \"script\": \"" << scriptName << "\",\n";
+			file << "  \"renderer\": \"" << Renderer << "\",\n";
+			file << "  \"frames\": " << FrameTimes.size() << ",\n";
+			file << "  \"warmupFrames\": " << WarmupFrames << ",\n";
+			file << "  \"drawCallsPerFrame\": " << drawCallsPerFrame() << ",\n";
+			file << "  \"visibleObjectsPerFrame\": " << perFrame(VisibleObjects) << ",\n";
+			file << "  \"culledObjectsPerFrame\": " << perFrame(CulledObjects) << ",\n";
+			file << "  \"stateChangesIssuedPerFrame\": " << perFrame(StateChangesIssued) << ",\n";
+			file << "  \"stateChangesSkippedPerFrame\": " << perFrame(StateChangesSkipped) << ",\n";
+			file << "  \"streamedBytesPerFrame\": " << perFrame(StreamedBytes) << ",\n";
+			file << "  \"streamStalls\": " << StreamStalls << ",\n";
+			file << "  \"streamStallMs\": " << StreamStallTime << ",\n";
+			file << "  \"allocationsPerFrame\": " << perFrame(Allocations) << ",\n";
+			file << "  \"allocatedBytesPerFrame\": " << perFrame(AllocatedBytes) << ",\n";
+			writeJsonSeries(file, "frameMs", FrameTimes);
+			file << ",\n";
+			writeJsonSeries(file, "cpuMs", CpuTimes);
+			file << ",\n";
+			writeJsonSeries(file, "gpuMs", GpuTimes);
+			file << "\n}\n";
+		}
+		else
+		{
+			file << "frame,frame_ms,cpu_ms,gpu_ms\n";
+			for (size_t i = 0; i < FrameTimes.size(); i++)
+				file << i << "," << FrameTimes[i] << "," << CpuTimes[i] << "," << (i < GpuTimes.size() ? GpuTimes[i] : 0.0f) << "\n";
+		}
+
+		return true;
+	}
+
+private:
+	static const int QueryCount = 4;
+	unsigned int queries[QueryCount];
+	int frame;
+	std::chrono::steady_clock::time_point frameStart, cpuEnd;
+	long long allocationsStart, allocatedBytesStart;
+
+	double drawCallsPerFrame() const
+	{
+		return perFrame(DrawCalls);
+	}
+
+	double perFrame(long long total) const
+	{
+		return FrameTimes.empty() ? 0.0 : (double)total / FrameTimes.size();
+	}
+
+	void collectQuery(int queryFrame)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[queryFrame % QueryCount], GL_QUERY_RESULT, &elapsed);
+		if (queryFrame >= WarmupFrames)
+			GpuTimes.push_back((float)(elapsed / 1.0e6));
+	}
+
+	static void printStatistics(std::ostream& out, const char* label, const FrameStatistics& stats)
+	{
+		out << "  " << label << " ms: mean " << stats.Mean << ", p50 " << stats.P50 << ", p95 " << stats.P95
+			<< ", p99 " << stats.P99 << ", max " << stats.Max << std::endl;
+	}
+
+	static void writeJsonSeries(std::ostream& out, const char* name, const std::vector<float>& samples)
+	{
+		FrameStatistics stats = FrameStatistics::compute(samples);
+		out << "  \"" << name << "\": {\n";
+		out << "    \"mean\": " << stats.Mean << ", \"p50\": " << stats.P50 << ", \"p95\": " << stats.P95
+			<< ", \"p99\": " << stats.P99 << ", \"max\": " << stats.Max << ",\n";
+		out << "    \"samples\": [";
+		for (size_t i = 0; i < samples.size(); i++)
+			out << (i ? ", " : "") << samples[i];
+		out << "]\n  }";
+	}
+};
@@ -1,6 +1,6 @@
 #pragma once
-#include <glad\glad.h>
-#include <glm\glm.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A linear (bump) allocator for data that only lives for one frame: draw lists, gathered matrices, lookup tables.
+// Allocating just moves an offset forward through a block of memory, and nothing is ever freed on its own: reset() drops
+// everything at once, when the frame's data isn't needed anymore. The memory itself is kept, so the next frame reuses it.
+// When a frame needs more than the block holds, more blocks are chained on from the heap. The next reset() replaces them with a
+// single block big enough for all of them, so after the first few frames the arena has found its size and never allocates again.
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t capacity = 64 * 1024) : data(NULL), size(0), offset(0), overflowBytes(0), peak(0)
+	{
+		grow(capacity);
+	}
+
+	~LinearArena()
+	{
+		release();
+		::operator delete(data);
+	}
+
+	// Allocate a number of bytes, aligned to alignment (a power of two).
+	void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+	{
+		size_t start = (offset + alignment - 1) & ~(alignment - 1);
+		if (start + bytes > size)
+		{
+			// Keep the full block alive until the next reset, its memory is still in use.
+			overflow.push_back(data);
+			overflowBytes += offset;
+			grow(std::max(size * 2, bytes + alignment));
+			start = (offset + alignment - 1) & ~(alignment - 1);
+		}
+
+		offset = start + bytes;
+		peak = std::max(peak, overflowBytes + offset);
+		return data + start;
+	}
+
+	// Drop everything allocated since the last reset. Blocks chained on since then are merged into one, with some room to spare,
+	// so a frame slightly bigger than the biggest one so far doesn't have to chain on another block.
+	void reset()
+	{
+		if (!overflow.empty())
+		{
+			release();
+			::operator delete(data);
+			grow(peak + peak / 4);
+		}
+		offset = 0;
+	}
+
+	// Bytes handed out since the last reset.
+	size_t used() const
+	{
+		return overflowBytes + offset;
+	}
+
+	size_t capacity() const
+	{
+		return size;
+	}
+
+private:
+	char* data;
+	size_t size;
+	size_t offset;
+
+	// Blocks filled up since the last reset, and the bytes used in them.
+	std::vector<char*> overflow;
+	size_t overflowBytes;
+
+	// Most bytes used between two resets, which is what the merged block has to hold.
+	size_t peak;
+
+	// Continue in a new block of at least capacity bytes.
+	void grow(size_t capacity)
+	{
+		size = capacity;
+		data = (char*)::operator new(size);
+		offset = 0;
+	}
+
+	void release()
+	{
+		for (size_t i = 0; i < overflow.size(); i++)
+			::operator delete(overflow[i]);
+		overflow.clear();
+		overflowBytes = 0;
+	}
+
+	// The containers allocating from an arena point to it, so it can't be copied.
+	LinearArena(const LinearArena&);
+	LinearArena& operator=(const LinearArena&);
+};
+
+// Lets standard containers allocate from a LinearArena. Deallocating does nothing, the memory comes back with the arena's reset().
+// Containers keep a pointer to the arena, so a container must not be used after the arena was reset: create it anew for every frame.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	// Assigning or swapping containers switches them over to the other container's arena, along with the memory they take over.
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	LinearArena* Arena;
+
+	explicit ArenaAllocator(LinearArena* arena) : Arena(arena)
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : Arena(other.Arena)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return (T*)Arena->allocate(count * sizeof(T), alignof(T));
+	}
+
+	void deallocate(T*, size_t)
+	{
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return a.Arena == b.Arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+	return a.Arena != b.Arena;
+}
+
+// Containers for data that only lives for one frame, allocating from the frame's arena. Construct them with an allocator of the
+// arena (of any type, it converts to the one the container needs):
+//	ArenaAllocator<void> allocator(&arena);
+//	FrameVector<unsigned int> drawList(allocator);
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key> >
+using FrameHashMap = std::unordered_map<Key, Value, Hash, Equal, ArenaAllocator<std::pair<const Key, Value> > >;
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Benchmark.h"
+#include "FrameArena.h"
+#include "UniformBuffer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The state the simulation produces for a frame: where the camera is and what time it is.
+// It's a copy, so the simulation can move on to the next frame while this one is being prepared.
+struct SimulationFrame
+{
+	int Frame;
+	float Time;
+	CameraPose Camera;
+};
+
+// Everything the OpenGL thread needs to submit a frame, built by render preparation: the per-frame uniforms, and a draw packet
+// (the model matrix) per cube that survived culling, in draw order.
+// The frame's lists are allocated from its own arena, which is reset when the frame is prepared again. Every frame in flight
+// (each slot of the pipeline, or the single frame of the render thread) has an arena of its own, so resetting one never pulls
+// the memory out from under a frame that's still being submitted.
+struct RenderFrame
+{
+	int Frame;
+	FrameUniforms Uniforms;
+	LinearArena Arena;
+	FrameVector<unsigned int> DrawList;
+	FrameVector<glm::mat4> Models;
+	size_t Visible;
+	size_t Culled;
+
+	RenderFrame() : Frame(0), DrawList(ArenaAllocator<void>(&Arena)), Models(ArenaAllocator<void>(&Arena)), Visible(0), Culled(0)
+	{
+	}
+
+	// Start preparing the frame anew: drop the lists of the last frame prepared here and reuse their memory.
+	void reset()
+	{
+		ArenaAllocator<void> allocator(&Arena);
+		DrawList = FrameVector<unsigned int>(allocator);
+		Models = FrameVector<glm::mat4>(allocator);
+		Arena.reset();
+	}
+};
+
+// A double buffered handoff between two pipeline stages running on different threads.
+// The producer fills one slot while the consumer reads the other, and each side only waits when it gets two frames ahead of
+// the other one. Slots are reused, so their vectors (or arenas) keep their memory and a frame in flight doesn't allocate.
+template <typename T>
+class FrameChannel
+{
+public:
+	FrameChannel() : writeIndex(0), readIndex(0), filled(0), closed(false)
+	{
+	}
+
+	// Wait for a free slot to fill. Returns NULL when the channel was closed.
+	T* beginWrite()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return closed || filled < 2; });
+		return closed ? NULL : &slots[writeIndex];
+	}
+
+	void endWrite()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			writeIndex ^= 1;
+			filled++;
+		}
+		changed.notify_all();
+	}
+
+	// Wait for a filled slot to read. Returns NULL when the channel was closed and every filled slot has been read.
+	T* beginRead()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return closed || filled > 0; });
+		return filled > 0 ? &slots[readIndex] : NULL;
+	}
+
+	void endRead()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			readIndex ^= 1;
+			filled--;
+		}
+		changed.notify_all();
+	}
+
+	// Wake up both sides for good: no more slots are handed out for writing, and reading stops once the filled slots are read.
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		changed.notify_all();
+	}
+
+private:
+	T slots[2];
+	int writeIndex;
+	int readIndex;
+	int filled;
+	bool closed;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
+
+// Runs the CPU work of a frame as a pipeline over three threads:
+//	- the simulation thread advances the world (here: the camera) to frame N+2,
+//	- the preparation thread culls, sorts and gathers the model matrices of frame N+1 into a RenderFrame,
+//	- while the OpenGL thread (the one owning the context) only submits the prepared frame N.
+// The stages hand their frames over through double buffered FrameChannels, so no stage ever touches data another stage is
+// working on, and each stage only waits when it gets two frames ahead of the next. When one stage dominates the frame time, the
+// others come for free on their own cores, so the frame rate is set by the slowest stage instead of the sum of all of them.
+// The price is latency: a frame is shown a few frames after it was simulated.
+class FramePipeline
+{
+public:
+	typedef std::function<void(int frame, SimulationFrame& simulation)> SimulateFunction;
+	typedef std::function<void(const SimulationFrame& simulation, RenderFrame& render)> PrepareFunction;
+
+	// Milliseconds the simulation and preparation stages spent working, and the OpenGL thread spent waiting for prepared frames.
+	// The stage times are written by the pipeline's threads, so they can only be read after stop().
+	double SimulationTime;
+	double PreparationTime;
+	double SubmitWaitTime;
+	int Submitted;
+
+	FramePipeline() : SimulationTime(0.0), PreparationTime(0.0), SubmitWaitTime(0.0), Submitted(0), running(false)
+	{
+	}
+
+	~FramePipeline()
+	{
+		stop();
+	}
+
+	// Start simulating and preparing frames 0 to frameCount - 1, or until stop() when frameCount is negative.
+	// The functions are called on the pipeline's threads, so they must not touch OpenGL or anything the OpenGL thread uses.
+	void start(int frameCount, SimulateFunction simulate, PrepareFunction prepare)
+	{
+		this->frameCount = frameCount;
+		this->simulate = simulate;
+		this->prepare = prepare;
+		running = true;
+		simulationThread = std::thread(&FramePipeline::simulationMain, this);
+		preparationThread = std::thread(&FramePipeline::preparationMain, this);
+	}
+
+	// Wait for the next prepared frame, on the OpenGL thread. Returns NULL once all frames have been handed out.
+	RenderFrame* acquire()
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RenderFrame* frame = prepared.beginRead();
+		SubmitWaitTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return frame;
+	}
+
+	// Input is only reported on the main thread (GLFW), so the simulation takes the camera as last moved by the input handling there.
+	void setCamera(const CameraPose& pose)
+	{
+		std::lock_guard<std::mutex> lock(cameraMutex);
+		inputCamera = pose;
+	}
+
+	CameraPose camera()
+	{
+		std::lock_guard<std::mutex> lock(cameraMutex);
+		return inputCamera;
+	}
+
+	// Hand the frame returned by acquire() back to the preparation thread, once it has been submitted.
+	void release()
+	{
+		prepared.endRead();
+		Submitted++;
+	}
+
+	// Stop both threads, dropping the frames still in flight.
+	void stop()
+	{
+		if (!running)
+			return;
+
+		simulated.close();
+		prepared.close();
+		simulationThread.join();
+		preparationThread.join();
+		running = false;
+	}
+
+	void printStatistics(std::ostream& out) const
+	{
+		if (Submitted == 0)
+			return;
+
+		out << "Frame pipeline: " << Submitted << " frames, per frame: simulation " << SimulationTime / Submitted << " ms, preparation "
+			<< PreparationTime / Submitted << " ms, submission waited " << SubmitWaitTime / Submitted << " ms" << std::endl;
+	}
+
+private:
+	int frameCount;
+	SimulateFunction simulate;
+	PrepareFunction prepare;
+	bool running;
+
+	std::mutex cameraMutex;
+	CameraPose inputCamera;
+
+	FrameChannel<SimulationFrame> simulated;
+	FrameChannel<RenderFrame> prepared;
+	std::thread simulationThread;
+	std::thread preparationThread;
+
+	void simulationMain()
+	{
+		for (int frame = 0; frameCount < 0 || frame < frameCount; frame++)
+		{
+			SimulationFrame* simulation = simulated.beginWrite();
+			if (!simulation)
+				return;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			simulate(frame, *simulation);
+			SimulationTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			simulated.endWrite();
+		}
+		simulated.close();
+	}
+
+	void preparationMain()
+	{
+		while (SimulationFrame* simulation = simulated.beginRead())
+		{
+			RenderFrame* render = prepared.beginWrite();
+			if (!render)
+				return;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			prepare(*simulation, *render);
+			PreparationTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			simulated.endRead();
+			prepared.endWrite();
+		}
+		prepared.close();
+	}
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// GLM detects the instruction sets the compiler may use (GLM_ARCH), and ships SSE kernels operating on glm_vec4 (__m128).
+// The culling loops below build on those, and process 8 spheres per iteration when AVX is enabled.
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <glm/simd/common.h>
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+#include <immintrin.h>
+#endif
+
+// The 6 planes of a view frustum, in world space.
+// Each plane is stored as (a, b, c, d) with a normalized (a, b, c) pointing into the frustum, so for a point p the
+// signed distance to the plane is dot(abc, p) + d, positive on the inside.
+struct Frustum
+{
+	glm::vec4 Planes[6];
+
+	// Extract the planes from a view-projection matrix (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+	// World-View-Projection Matrix"). A point is inside the clip volume when -w <= x, y, z <= w, and every one of those
+	// inequalities is a plane equation built from the rows of the matrix.
+	static Frustum fromMatrix(const glm::mat4& viewProjection)
+	{
+		// GLM matrices are column major, m[column][row].
+		const glm::mat4& m = viewProjection;
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		Frustum frustum;
+		frustum.Planes[0] = row3 + row0;	// left
+		frustum.Planes[1] = row3 - row0;	// right
+		frustum.Planes[2] = row3 + row1;	// bottom
+		frustum.Planes[3] = row3 - row1;	// top
+		frustum.Planes[4] = row3 + row2;	// near
+		frustum.Planes[5] = row3 - row2;	// far
+
+		for (int i = 0; i < 6; i++)
+			frustum.Planes[i] /= glm::length(glm::vec3(frustum.Planes[i]));
+
+		return frustum;
+	}
+};
+
+// Bounding spheres of a list of objects, in structure-of-arrays (SoA) layout.
+// Storing every component in its own array means 4 (SSE) or 8 (AVX) consecutive spheres can be loaded into registers with a
+// single instruction per component, instead of shuffling them out of an array of glm::vec4.
+struct BoundingSpheres
+{
+	std::vector<float> X, Y, Z, Radius;
+
+	size_t size() const
+	{
+		return X.size();
+	}
+
+	void reserve(size_t count)
+	{
+		X.reserve(count);
+		Y.reserve(count);
+		Z.reserve(count);
+		Radius.reserve(count);
+	}
+
+	void push_back(const glm::vec3& center, float radius)
+	{
+		X.push_back(center.x);
+		Y.push_back(center.y);
+		Z.push_back(center.z);
+		Radius.push_back(radius);
+	}
+};
+
+// Tests bounding spheres against a frustum, producing the list of objects that may be visible.
+// A sphere is culled as soon as it's completely on the outside of any of the 6 planes.
+class FrustumCuller
+{
+public:
+	// Results of the last cull() call.
+	size_t Visible;
+	size_t Culled;
+
+	FrustumCuller() : Visible(0), Culled(0)
+	{
+	}
+
+	// Write the indices of the potentially visible spheres into visible (replacing its contents), using the widest
+	// instruction set available. Returns the number of visible spheres.
+	template <typename Allocator>
+	size_t cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int, Allocator>& visible)
+	{
+		visible.resize(spheres.size());
+		size_t count = 0;
+		size_t i = 0;
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		count = cullAVX(frustum, spheres, visible.data(), i);
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		count = cullSSE(frustum, spheres, visible.data(), i);
+#endif
+
+		// Whatever doesn't fill a whole SIMD register is tested one by one.
+		count += cullScalar(frustum, spheres, visible.data() + count, i);
+
+		return finish(spheres, visible, count);
+	}
+
+	// Reference implementation testing one sphere at a time, used to verify and benchmark the SIMD paths.
+	template <typename Allocator>
+	size_t cullReference(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int, Allocator>& visible)
+	{
+		visible.resize(spheres.size());
+		size_t i = 0;
+		size_t count = cullScalar(frustum, spheres, visible.data(), i);
+		return finish(spheres, visible, count);
+	}
+
+private:
+	template <typename Allocator>
+	size_t finish(const BoundingSpheres& spheres, std::vector<unsigned int, Allocator>& visible, size_t count)
+	{
+		visible.resize(count);
+		Visible = count;
+		Culled = spheres.size() - count;
+		return count;
+	}
+
+	// Test spheres [first, size) one at a time.
+	static size_t cullScalar(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible, size_t& first)
+	{
+		size_t count = 0;
+		for (size_t i = first; i < spheres.size(); i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				const glm::vec4& plane = frustum.Planes[p];
+				// Same order of operations as the SIMD paths, so all paths agree on spheres touching a plane.
+				float distance = plane.x * spheres.X[i] + plane.w + plane.y * spheres.Y[i] + plane.z * spheres.Z[i];
+				inside = distance + spheres.Radius[i] >= 0.0f;
+			}
+			if (inside)
+				visible[count++] = (unsigned int)i;
+		}
+		first = spheres.size();
+		return count;
+	}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	// Test 4 spheres per iteration. Advances first past the last whole group of 4.
+	static size_t cullSSE(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible, size_t& first)
+	{
+		glm_vec4 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int c = 0; c < 4; c++)
+				planes[p][c] = _mm_set1_ps(frustum.Planes[p][c]);
+
+		const glm_vec4 zero = _mm_setzero_ps();
+		const size_t end = spheres.size() & ~(size_t)3;
+		size_t count = 0;
+		for (size_t i = 0; i < end; i += 4)
+		{
+			glm_vec4 x = _mm_loadu_ps(&spheres.X[i]);
+			glm_vec4 y = _mm_loadu_ps(&spheres.Y[i]);
+			glm_vec4 z = _mm_loadu_ps(&spheres.Z[i]);
+			glm_vec4 r = _mm_loadu_ps(&spheres.Radius[i]);
+
+			// distance + radius >= 0 for every plane.
+			glm_vec4 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				glm_vec4 distance = glm_vec4_add(glm_vec4_mul(planes[p][0], x), planes[p][3]);
+				distance = glm_vec4_add(distance, glm_vec4_mul(planes[p][1], y));
+				distance = glm_vec4_add(distance, glm_vec4_mul(planes[p][2], z));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(glm_vec4_add(distance, r), zero));
+			}
+
+			// Append the indices of the visible spheres, one bit per sphere.
+			int mask = _mm_movemask_ps(inside);
+			while (mask)
+			{
+				int bit = 0;
+				while (!(mask & (1 << bit)))
+					bit++;
+				visible[count++] = (unsigned int)(i + bit);
+				mask &= mask - 1;
+			}
+		}
+
+		first = end;
+		return count;
+	}
+#endif
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+	// Test 8 spheres per iteration. Advances first past the last whole group of 8.
+	static size_t cullAVX(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible, size_t& first)
+	{
+		__m256 planes[6][4];
+		for (int p = 0; p < 6; p++)
+			for (int c = 0; c < 4; c++)
+				planes[p][c] = _mm256_set1_ps(frustum.Planes[p][c]);
+
+		const __m256 zero = _mm256_setzero_ps();
+		const size_t end = spheres.size() & ~(size_t)7;
+		size_t count = 0;
+		for (size_t i = 0; i < end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&spheres.X[i]);
+			__m256 y = _mm256_loadu_ps(&spheres.Y[i]);
+			__m256 z = _mm256_loadu_ps(&spheres.Z[i]);
+			__m256 r = _mm256_loadu_ps(&spheres.Radius[i]);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(planes[p][0], x), planes[p][3]);
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][1], y));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planes[p][2], z));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+			}
+
+			int mask = _mm256_movemask_ps(inside);
+			while (mask)
+			{
+				int bit = 0;
+				while (!(mask & (1 << bit)))
+					bit++;
+				visible[count++] = (unsigned int)(i + bit);
+				mask &= mask - 1;
+			}
+		}
+
+		first = end;
+		return count;
+	}
+#endif
+};
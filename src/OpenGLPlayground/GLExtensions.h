@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// GLAD was generated for the OpenGL 3.3 core profile without any extensions, so functionality from newer OpenGL versions
+// is loaded here by hand. Every feature is only used when the driver reports support for it, either through its
+// OpenGL version or through the matching extension, so the playground keeps working on plain 3.3 drivers.
+
+// GL_ARB_get_program_binary (core in OpenGL 4.1).
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// GL_ARB_buffer_storage (core in OpenGL 4.4).
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// GL_KHR_parallel_shader_compile (GL_ARB_parallel_shader_compile uses the same values).
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+struct GLExtensions
+{
+	// Program binaries: retrieve a linked program as a driver specific blob, and load it again later without compiling.
+	bool ProgramBinary;
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+	PFNGLPROGRAMBINARYPROC ProgramBinaryLoad;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+
+	// Buffer storage: immutable buffers, which can stay mapped while the GPU reads from them (persistent mapping).
+	bool BufferStorage;
+	PFNGLBUFFERSTORAGEPROC BufferStorageData;
+
+	// Parallel shader compile: the driver compiles and links on its own threads, and GL_COMPLETION_STATUS_KHR tells whether it's done
+	// without blocking.
+	bool ParallelShaderCompile;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads;
+
+	GLExtensions() : ProgramBinary(false), GetProgramBinary(NULL), ProgramBinaryLoad(NULL), ProgramParameteri(NULL),
+		BufferStorage(false), BufferStorageData(NULL), ParallelShaderCompile(false), MaxShaderCompilerThreads(NULL)
+	{
+	}
+
+	// Load the function pointers through the same loader GLAD used. Must be called with the context current.
+	void load(GLADloadproc loader)
+	{
+		GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+		ProgramBinaryLoad = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+		ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+
+		// A driver may support the extension without supporting any binary format (e.g. when its own shader cache is disabled).
+		int binaryFormats = 0;
+		if (supports(4, 1, "GL_ARB_get_program_binary"))
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+		ProgramBinary = binaryFormats > 0 && GetProgramBinary && ProgramBinaryLoad && ProgramParameteri;
+
+		BufferStorageData = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+		BufferStorage = BufferStorageData && supports(4, 4, "GL_ARB_buffer_storage");
+
+		// Not core in any OpenGL version, so only the extensions count.
+		if (hasExtension("GL_KHR_parallel_shader_compile"))
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+		else if (hasExtension("GL_ARB_parallel_shader_compile"))
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsARB");
+		ParallelShaderCompile = MaxShaderCompilerThreads != NULL;
+	}
+
+	// Whether the context is at least OpenGL major.minor, or otherwise exposes the given extension.
+	static bool supports(int major, int minor, const char* extension)
+	{
+		int contextMajor = 0, contextMinor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+		glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+		if (contextMajor > major || (contextMajor == major && contextMinor >= minor))
+			return true;
+		return hasExtension(extension);
+	}
+
+	static bool hasExtension(const char* extension)
+	{
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count; i++)
+		{
+			if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), extension) == 0)
+				return true;
+		}
+		return false;
+	}
+};
+
+// The extensions of the current context, loaded once right after GLAD.
+inline GLExtensions& glExtensions()
+{
+	static GLExtensions extensions;
+	return extensions;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Benchmark.h"
+#include "Image.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A camera pose the golden image suite renders the scene from: frame Frame of the camera script Script.
+struct GoldenPose
+{
+	const char* Name;
+	const char* Script;
+	int Frame;
+};
+
+// Regression test for the rendered pixels.
+// The scene is rendered from a fixed set of camera poses and every frame is compared against a stored PNG (the golden image).
+// Renderers (and drivers) may legitimately differ by a bit here and there, so instead of requiring identical bytes, pixels are compared
+// with a perceptual color difference, and a frame only fails when too many pixels differ noticeably.
+// For a failed frame, the rendered image and a diff image (differing pixels in red over a faded copy of the golden image) are written
+// next to the golden image.
+class GoldenSuite
+{
+public:
+	// Golden images are rendered at a reduced size, they're stored in the repository.
+	static const int Width = 320;
+	static const int Height = 240;
+
+	std::string Directory;
+
+	// Write the rendered frames as the new golden images instead of comparing against them.
+	bool Update;
+
+	// Maximum perceptual difference of two matching pixels, from 0 (identical) to 1 (black versus white).
+	float Threshold;
+
+	// Fraction of the pixels allowed to differ before a frame fails.
+	float Tolerance;
+
+	int Passed, Failed;
+
+	GoldenSuite(const std::string& directory, bool update = false)
+		: Directory(directory), Update(update), Threshold(0.1f), Tolerance(0.005f), Passed(0), Failed(0)
+	{
+	}
+
+	static const std::vector<GoldenPose>& poses()
+	{
+		static const GoldenPose list[] = {
+			{ "static", "static", 0 },
+			{ "orbit-0", "orbit", 0 },
+			{ "orbit-300", "orbit", 300 },
+			{ "flythrough-90", "flythrough", 90 },
+			{ "flythrough-420", "flythrough", 420 },
+			{ "flythrough-900", "flythrough", 900 }
+		};
+		static const std::vector<GoldenPose> poses(list, list + sizeof(list) / sizeof(list[0]));
+		return poses;
+	}
+
+	static CameraPose evaluate(const GoldenPose& pose)
+	{
+		return CameraScript(pose.Script).evaluate(pose.Frame);
+	}
+
+	// Compare (or store) a rendered frame: RGBA pixels with rows bottom to top, like glReadPixels returns them.
+	bool check(const GoldenPose& pose, const std::vector<unsigned char>& pixels, int width, int height)
+	{
+		std::string path = Directory + "/" + pose.Name + ".png";
+		std::vector<unsigned char> rgb = toRGB(pixels);
+
+		if (Update)
+		{
+			if (!Image::writePNG(path, width, height, 3, rgb.data(), true))
+				return false;
+			std::cout << "Golden: wrote " << path << std::endl;
+			Passed++;
+			return true;
+		}
+
+		// Decode bottom to top as well, so the rows line up with the rendered pixels.
+		stbi_set_flip_vertically_on_load(true);
+		int goldenWidth = 0, goldenHeight = 0, channels = 0;
+		unsigned char* golden = stbi_load(path.c_str(), &goldenWidth, &goldenHeight, &channels, 3);
+		if (!golden)
+		{
+			std::cout << "Golden: FAILED " << pose.Name << ", can't read " << path << std::endl;
+			Failed++;
+			return false;
+		}
+		if (goldenWidth != width || goldenHeight != height)
+		{
+			std::cout << "Golden: FAILED " << pose.Name << ", golden image is " << goldenWidth << "x" << goldenHeight
+				<< " instead of " << width << "x" << height << std::endl;
+			stbi_image_free(golden);
+			Failed++;
+			return false;
+		}
+
+		std::vector<unsigned char> diff(rgb.size());
+		int different = 0;
+		float maxDelta = 0.0f;
+		for (size_t i = 0; i < rgb.size(); i += 3)
+		{
+			float delta = perceptualDelta(&golden[i], &rgb[i]);
+			maxDelta = std::max(maxDelta, delta);
+
+			if (delta > Threshold)
+			{
+				different++;
+				diff[i] = 255;
+				diff[i + 1] = 0;
+				diff[i + 2] = 0;
+			}
+			else
+			{
+				// Faded grey version of the golden image, so the red pixels can be placed.
+				unsigned char grey = (unsigned char)(191 + luminance(&golden[i]) / 4.0f);
+				diff[i] = diff[i + 1] = diff[i + 2] = grey;
+			}
+		}
+		stbi_image_free(golden);
+
+		float fraction = (float)different / (width * height);
+		bool passed = fraction <= Tolerance;
+		std::cout << "Golden: " << (passed ? "passed " : "FAILED ") << pose.Name << ", " << different << " pixels differ ("
+			<< fraction * 100.0f << "%, max difference " << maxDelta << ")" << std::endl;
+
+		if (passed)
+		{
+			Passed++;
+			return true;
+		}
+
+		Failed++;
+		Image::writePNG(Directory + "/" + pose.Name + "-actual.png", width, height, 3, rgb.data(), true);
+		Image::writePNG(Directory + "/" + pose.Name + "-diff.png", width, height, 3, diff.data(), true);
+		return false;
+	}
+
+	// Print the result of the suite. Returns true if every frame passed.
+	bool printSummary(std::ostream& out) const
+	{
+		out << "Golden: " << Passed << " passed, " << Failed << " failed" << std::endl;
+		return Failed == 0;
+	}
+
+	// Perceptual difference between two RGB colors, from 0 to 1.
+	// Colors are compared in the YIQ color space with the weights of Kotsarenko and Ramos, "Measuring perceived color difference
+	// using YIQ NTSC transmission color space in mobile applications": brightness (Y) differences matter most, and the eye is less
+	// sensitive to the two chroma axes (I and Q). The result is normalized so black versus white is 1.
+	static float perceptualDelta(const unsigned char* a, const unsigned char* b)
+	{
+		float dr = (float)a[0] - b[0];
+		float dg = (float)a[1] - b[1];
+		float db = (float)a[2] - b[2];
+		float y = dr * 0.29889531f + dg * 0.58662247f + db * 0.11448223f;
+		float i = dr * 0.59597799f - dg * 0.27417610f - db * 0.32180189f;
+		float q = dr * 0.21147017f - dg * 0.52261711f + db * 0.31114694f;
+		return sqrt((0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q) / 35215.0f);
+	}
+
+private:
+	static float luminance(const unsigned char* rgb)
+	{
+		return rgb[0] * 0.29889531f + rgb[1] * 0.58662247f + rgb[2] * 0.11448223f;
+	}
+
+	// Golden images don't store alpha: the window's alpha channel is never shown, and how it ends up in an offscreen framebuffer varies.
+	static std::vector<unsigned char> toRGB(const std::vector<unsigned char>& rgba)
+	{
+		std::vector<unsigned char> rgb(rgba.size() / 4 * 3);
+		for (size_t i = 0, j = 0; i < rgba.size(); i += 4, j += 3)
+		{
+			rgb[j] = rgba[i];
+			rgb[j + 1] = rgba[i + 1];
+			rgb[j + 2] = rgba[i + 2];
+		}
+		return rgb;
+	}
+};
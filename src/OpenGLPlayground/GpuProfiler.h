@@ -0,0 +1,329 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures how long the CPU and the GPU spend on each part (scope) of a frame.
+// The GPU runs behind the CPU, so its timings can't be taken with a clock around the code that issues the commands.
+// Instead every scope writes a GL_TIMESTAMP query (glQueryCounter) at its start and end, and the GPU records its clock when it
+// gets there. Timestamps nest, unlike GL_TIME_ELAPSED queries, of which only one can be active at a time.
+// Reading a query result before the GPU is done blocks the CPU, so the queries of a frame are only read FrameLatency frames later,
+// when they have most likely finished. If they still haven't, the frame's GPU timings are dropped rather than waited for.
+//
+// The GPU clock is lined up with the CPU clock once, when the profiler is created, so CPU and GPU scopes share the same timeline
+// (in milliseconds since creation) and can be viewed together in a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+class GpuProfiler
+{
+public:
+	// Number of frames the query results are read after. Every frame in flight needs its own set of queries.
+	static const int FrameLatency = 3;
+
+	// A timed scope of a frame. Times are in milliseconds on the shared timeline; the GPU times are only valid if HasGpuTime is set.
+	struct Scope
+	{
+		const char* Name;
+		int Depth;
+		double CpuStart, CpuEnd;
+		double GpuStart, GpuEnd;
+		bool HasGpuTime;
+	};
+
+	// Running averages of a scope over the recent frames, in milliseconds.
+	struct Average
+	{
+		const char* Name;
+		int Depth;
+		double Cpu;
+		double Gpu;
+	};
+
+	bool Enabled;
+
+	// Keep the scopes of every frame, for writeChromeTrace().
+	bool KeepTrace;
+
+	// Frames whose timings have been collected, and frames whose GPU timings were dropped because they weren't available in time.
+	int CollectedFrames;
+	int DroppedFrames;
+
+	// Averages of every scope, in the order the scopes are opened in a frame.
+	std::vector<Average> Averages;
+
+	GpuProfiler() : Enabled(false), KeepTrace(false), CollectedFrames(0), DroppedFrames(0), frame(0), gpuEpoch(0)
+	{
+	}
+
+	// Start profiling. Must be called with the context current.
+	void create(bool keepTrace)
+	{
+		Enabled = true;
+		KeepTrace = keepTrace;
+
+		// Line up the clocks: the GPU's current timestamp corresponds to the CPU's current time.
+		cpuEpoch = std::chrono::steady_clock::now();
+		glGetInteger64v(GL_TIMESTAMP, &gpuEpoch);
+	}
+
+	// Start a frame. Collects the results of the frame that used this frame's queries before, and opens the root "frame" scope.
+	void beginFrame()
+	{
+		if (!Enabled)
+			return;
+
+		FrameQueries& slot = frames[frame % FrameLatency];
+		if (slot.Frame >= 0)
+			collect(slot, false);
+
+		slot.Frame = frame;
+		slot.Scopes.clear();
+		slot.Open.clear();
+		beginScope("frame");
+	}
+
+	// End the frame, closing the root scope. Call before presenting, so the swap doesn't count as CPU time.
+	void endFrame()
+	{
+		if (!Enabled)
+			return;
+
+		FrameQueries& slot = frames[frame % FrameLatency];
+		while (!slot.Open.empty())
+			endScope();
+		frame++;
+	}
+
+	void beginScope(const char* name)
+	{
+		if (!Enabled)
+			return;
+
+		FrameQueries& slot = frames[frame % FrameLatency];
+		int index = (int)slot.Scopes.size();
+
+		// Every scope needs a query for its start and one for its end. Queries are created once and reused every FrameLatency frames.
+		if ((int)slot.Queries.size() < 2 * (index + 1))
+		{
+			slot.Queries.resize(2 * (index + 1));
+			glGenQueries(2, &slot.Queries[2 * index]);
+		}
+
+		Scope scope;
+		scope.Name = name;
+		scope.Depth = (int)slot.Open.size();
+		scope.CpuStart = now();
+		scope.CpuEnd = scope.CpuStart;
+		scope.GpuStart = scope.GpuEnd = 0.0;
+		scope.HasGpuTime = false;
+		slot.Scopes.push_back(scope);
+		slot.Open.push_back(index);
+
+		glQueryCounter(slot.Queries[2 * index], GL_TIMESTAMP);
+	}
+
+	void endScope()
+	{
+		if (!Enabled)
+			return;
+
+		FrameQueries& slot = frames[frame % FrameLatency];
+		if (slot.Open.empty())
+			return;
+
+		int index = slot.Open.back();
+		slot.Open.pop_back();
+		glQueryCounter(slot.Queries[2 * index + 1], GL_TIMESTAMP);
+		slot.Scopes[index].CpuEnd = now();
+	}
+
+	// Collect the frames still in flight, waiting for the GPU to finish them, and release the queries. Call once after the last frame.
+	void finish()
+	{
+		if (!Enabled)
+			return;
+
+		for (int i = 0; i < FrameLatency; i++)
+		{
+			FrameQueries& slot = frames[(frame + i) % FrameLatency];
+			if (slot.Frame >= 0)
+				collect(slot, true);
+			if (!slot.Queries.empty())
+				glDeleteQueries((GLsizei)slot.Queries.size(), slot.Queries.data());
+			slot.Queries.clear();
+			slot.Frame = -1;
+		}
+		Enabled = false;
+	}
+
+	void printSummary(std::ostream& out) const
+	{
+		out << "Profiler: " << CollectedFrames << " frames, " << DroppedFrames << " without GPU timings (not available in time)" << std::endl;
+		for (size_t i = 0; i < Averages.size(); i++)
+		{
+			out << "  " << std::string(2 * Averages[i].Depth, ' ') << Averages[i].Name << ": cpu " << Averages[i].Cpu
+				<< " ms, gpu " << Averages[i].Gpu << " ms" << std::endl;
+		}
+	}
+
+	// Write the collected scopes in the Chrome trace event format: the CPU scopes on one track and the GPU scopes on another.
+	bool writeChromeTrace(const std::string& path) const
+	{
+		std::ofstream file(path.c_str());
+		if (!file)
+		{
+			std::cout << "ERROR::PROFILER::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+
+		file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n";
+		file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}";
+		for (size_t i = 0; i < trace.size(); i++)
+		{
+			const TraceFrame& traced = trace[i];
+			for (size_t j = 0; j < traced.Scopes.size(); j++)
+			{
+				const Scope& scope = traced.Scopes[j];
+				writeTraceEvent(file, scope.Name, 1, scope.CpuStart, scope.CpuEnd, traced.Frame);
+				if (scope.HasGpuTime)
+					writeTraceEvent(file, scope.Name, 2, scope.GpuStart, scope.GpuEnd, traced.Frame);
+			}
+		}
+		file << "\n]}\n";
+		return true;
+	}
+
+private:
+	// The scopes of a frame and the queries they use.
+	struct FrameQueries
+	{
+		int Frame;
+		std::vector<Scope> Scopes;
+		std::vector<int> Open;
+		std::vector<unsigned int> Queries;
+
+		FrameQueries() : Frame(-1)
+		{
+		}
+	};
+
+	struct TraceFrame
+	{
+		int Frame;
+		std::vector<Scope> Scopes;
+	};
+
+	FrameQueries frames[FrameLatency];
+	std::vector<TraceFrame> trace;
+	int frame;
+	std::chrono::steady_clock::time_point cpuEpoch;
+	GLint64 gpuEpoch;
+
+	double now() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuEpoch).count();
+	}
+
+	// Read the timestamps of a frame. The GPU writes them in order, so once the last one (the end of the root scope) is available,
+	// all of them are.
+	void collect(FrameQueries& slot, bool wait)
+	{
+		if (slot.Scopes.empty())
+			return;
+
+		GLuint available = GL_TRUE;
+		if (!wait)
+			glGetQueryObjectuiv(slot.Queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available)
+		{
+			for (size_t i = 0; i < slot.Scopes.size(); i++)
+			{
+				GLuint64 start = 0, end = 0;
+				glGetQueryObjectui64v(slot.Queries[2 * i], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(slot.Queries[2 * i + 1], GL_QUERY_RESULT, &end);
+				slot.Scopes[i].GpuStart = (double)((GLint64)start - gpuEpoch) / 1000000.0;
+				slot.Scopes[i].GpuEnd = (double)((GLint64)end - gpuEpoch) / 1000000.0;
+				slot.Scopes[i].HasGpuTime = true;
+			}
+		}
+		else
+		{
+			DroppedFrames++;
+		}
+
+		CollectedFrames++;
+		updateAverages(slot.Scopes);
+
+		if (KeepTrace)
+		{
+			TraceFrame traced;
+			traced.Frame = slot.Frame;
+			traced.Scopes = slot.Scopes;
+			trace.push_back(traced);
+		}
+
+		slot.Scopes.clear();
+		slot.Frame = -1;
+	}
+
+	// Exponential moving average, which follows changes within a few dozen frames while smoothing out the noise.
+	void updateAverages(const std::vector<Scope>& scopes)
+	{
+		const double weight = 0.1;
+		for (size_t i = 0; i < scopes.size(); i++)
+		{
+			const Scope& scope = scopes[i];
+			Average* average = NULL;
+			for (size_t j = 0; j < Averages.size() && !average; j++)
+			{
+				if (strcmp(Averages[j].Name, scope.Name) == 0)
+					average = &Averages[j];
+			}
+
+			if (!average)
+			{
+				Average added = { scope.Name, scope.Depth, scope.CpuEnd - scope.CpuStart, scope.GpuEnd - scope.GpuStart };
+				Averages.push_back(added);
+				continue;
+			}
+
+			average->Cpu += weight * ((scope.CpuEnd - scope.CpuStart) - average->Cpu);
+			if (scope.HasGpuTime)
+				average->Gpu += weight * ((scope.GpuEnd - scope.GpuStart) - average->Gpu);
+		}
+	}
+
+	static void writeTraceEvent(std::ofstream& file, const char* name, int track, double start, double end, int frameIndex)
+	{
+		// Trace event times are in microseconds.
+		file << ",\n{\"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << track << ", \"ts\": " << start * 1000.0
+			<< ", \"dur\": " << (end - start) * 1000.0 << ", \"args\": {\"frame\": " << frameIndex << "}}";
+	}
+};
+
+// Times the rest of the enclosing block as a scope of the current frame.
+class ProfileScope
+{
+public:
+	ProfileScope(GpuProfiler& profiler, const char* name) : profiler(profiler)
+	{
+		profiler.beginScope(name);
+	}
+
+	~ProfileScope()
+	{
+		profiler.endScope();
+	}
+
+private:
+	GpuProfiler& profiler;
+
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "RenderState.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Headless rendering is built on EGL, which is what Mesa (llvmpipe/softpipe) and the GPU vendors expose on Linux
+// for rendering without a window system. Other platforms always render to a GLFW window.
+// The CMake build defines PLAYGROUND_NO_EGL when the EGL development files aren't installed.
+#if defined(__linux__) && !defined(PLAYGROUND_NO_EGL)
+#define PLAYGROUND_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// An OpenGL 3.3 core context without a window.
+// Instead of a default framebuffer provided by the window system, we render into our own framebuffer object (FBO),
+// consisting of a color renderbuffer and a depth/stencil renderbuffer. The FBO stays bound for the lifetime of the context,
+// so the render loop doesn't need to know whether it's drawing to a window or not.
+class HeadlessContext
+{
+public:
+	int Width;
+	int Height;
+
+	// Framebuffer object and its attachments that replace the window's default framebuffer.
+	unsigned int FBO, ColorRBO, DepthRBO;
+
+	HeadlessContext() : Width(0), Height(0), FBO(0), ColorRBO(0), DepthRBO(0)
+#ifdef PLAYGROUND_HAS_EGL
+		, display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT)
+#endif
+	{
+	}
+
+	~HeadlessContext()
+	{
+		destroy();
+	}
+
+	// Create the EGL context, make it current on the calling thread and load the OpenGL function pointers through GLAD.
+	bool create(int width, int height)
+	{
+		Width = width;
+		Height = height;
+
+#ifdef PLAYGROUND_HAS_EGL
+		// Prefer the surfaceless platform, as it doesn't need a display server, a GPU or even /dev/dri.
+		// If the EGL implementation doesn't support it, fall back to the default display.
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major, minor;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		{
+			std::cout << "Failed to initialize EGL display" << std::endl;
+			return false;
+		}
+
+		// We never render to an EGL surface, so any config that supports desktop OpenGL will do.
+		// EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which the surfaceless platform can't provide, so ask for pbuffer support instead.
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+		{
+			std::cout << "Failed to find an EGL config supporting OpenGL" << std::endl;
+			return false;
+		}
+
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cout << "Failed to bind the OpenGL API" << std::endl;
+			return false;
+		}
+
+		// Request the same context as the windowed path: OpenGL 3.3 core profile.
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context == EGL_NO_CONTEXT)
+		{
+			std::cout << "Failed to create EGL context" << std::endl;
+			return false;
+		}
+
+		// Make the context current without any draw or read surface (EGL_KHR_surfaceless_context).
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			std::cout << "Failed to make EGL context current" << std::endl;
+			return false;
+		}
+
+		if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return false;
+		}
+		glExtensions().load((GLADloadproc)eglGetProcAddress);
+
+		std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+
+		// Create the offscreen framebuffer we render into.
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+		glGenRenderbuffers(1, &ColorRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, ColorRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ColorRBO);
+
+		glGenRenderbuffers(1, &DepthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, DepthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, DepthRBO);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Failed to create headless framebuffer" << std::endl;
+			return false;
+		}
+
+		renderState().setViewport(0, 0, width, height);
+		startTime = std::chrono::steady_clock::now();
+		return true;
+#else
+		std::cout << "Headless rendering requires EGL, which isn't available in this build" << std::endl;
+		return false;
+#endif
+	}
+
+	// Seconds since the context was created, the headless counterpart to glfwGetTime.
+	double getTime() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// There is no front buffer to present to, so the end of a frame only has to make sure all commands were executed.
+	// Waiting here means the measured frame time includes the GPU work, just like a blocking glfwSwapBuffers would.
+	void finishFrame()
+	{
+		glFinish();
+	}
+
+	// Read back the color attachment as tightly packed RGBA rows (bottom row first, as OpenGL returns them).
+	std::vector<unsigned char> readPixels() const
+	{
+		std::vector<unsigned char> pixels((size_t)Width * Height * 4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	}
+
+	void destroy()
+	{
+#ifdef PLAYGROUND_HAS_EGL
+		if (context != EGL_NO_CONTEXT)
+		{
+			if (FBO != 0)
+			{
+				glDeleteRenderbuffers(1, &ColorRBO);
+				glDeleteRenderbuffers(1, &DepthRBO);
+				glDeleteFramebuffers(1, &FBO);
+				FBO = ColorRBO = DepthRBO = 0;
+			}
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(display, context);
+			context = EGL_NO_CONTEXT;
+		}
+		if (display != EGL_NO_DISPLAY)
+		{
+			eglTerminate(display);
+			display = EGL_NO_DISPLAY;
+		}
+#endif
+	}
+
+private:
+#ifdef PLAYGROUND_HAS_EGL
+	EGLDisplay display;
+	EGLContext context;
+#endif
+	std::chrono::steady_clock::time_point startTime;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal PNG writer used to dump framebuffer contents to disk.
+// stb_image.h can only decode images, so we write the file ourselves. The image data is stored
+// with uncompressed ("stored") deflate blocks, which keeps the writer tiny while still producing a
+// valid PNG that any viewer (and stb_image.h) can open.
+namespace Image
+{
+	inline uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc = 0)
+	{
+		static uint32_t table[256];
+		static bool tableReady = false;
+		if (!tableReady)
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+			tableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < length; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	inline void appendBigEndian(std::vector<unsigned char>& out, uint32_t value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	inline void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+	{
+		appendBigEndian(out, (uint32_t)data.size());
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		appendBigEndian(out, crc32(&out[start], out.size() - start));
+	}
+
+	// Write 8-bit RGB or RGBA pixels to a PNG file.
+	// OpenGL returns rows bottom-to-top from glReadPixels, so flipVertically should be set when writing a framebuffer read-back.
+	inline bool writePNG(const std::string& path, int width, int height, int channels, const unsigned char* pixels, bool flipVertically)
+	{
+		if (channels != 3 && channels != 4)
+		{
+			std::cout << "ERROR::IMAGE::UNSUPPORTED_CHANNEL_COUNT " << channels << std::endl;
+			return false;
+		}
+
+		// Every scanline is prefixed with a filter type byte (0 = none).
+		const size_t rowSize = (size_t)width * channels;
+		std::vector<unsigned char> raw;
+		raw.reserve((rowSize + 1) * height);
+		for (int y = 0; y < height; y++)
+		{
+			int row = flipVertically ? height - 1 - y : y;
+			raw.push_back(0);
+			raw.insert(raw.end(), pixels + row * rowSize, pixels + (row + 1) * rowSize);
+		}
+
+		// zlib stream made of stored deflate blocks (max 65535 bytes each), followed by the Adler-32 checksum.
+		std::vector<unsigned char> zlib;
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		size_t offset = 0;
+		do
+		{
+			size_t blockSize = raw.size() - offset;
+			if (blockSize > 65535)
+				blockSize = 65535;
+			bool last = offset + blockSize == raw.size();
+			zlib.push_back(last ? 1 : 0);
+			zlib.push_back((unsigned char)(blockSize & 0xFF));
+			zlib.push_back((unsigned char)(blockSize >> 8));
+			zlib.push_back((unsigned char)(~blockSize & 0xFF));
+			zlib.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < raw.size());
+
+		uint32_t a = 1, b = 0;
+		for (size_t i = 0; i < raw.size(); i++)
+		{
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		appendBigEndian(zlib, (b << 16) | a);
+
+		std::vector<unsigned char> header;
+		appendBigEndian(header, (uint32_t)width);
+		appendBigEndian(header, (uint32_t)height);
+		header.push_back(8);							// bit depth
+		header.push_back(channels == 4 ? 6 : 2);		// color type: RGBA or RGB
+		header.push_back(0);							// compression
+		header.push_back(0);							// filter
+		header.push_back(0);							// interlace
+
+		static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		std::vector<unsigned char> file(signature, signature + sizeof(signature));
+		appendChunk(file, "IHDR", header);
+		appendChunk(file, "IDAT", zlib);
+		appendChunk(file, "IEND", std::vector<unsigned char>());
+
+		std::ofstream stream(path.c_str(), std::ios::binary);
+		if (!stream)
+		{
+			std::cout << "ERROR::IMAGE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		stream.write((const char*)file.data(), file.size());
+		return true;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "RenderState.h"
+#include "StreamBuffer.h"
+
+// Draws many copies (instances) of the same mesh with a single draw call.
+// Instead of setting the model matrix as a uniform and issuing one glDrawArrays per object, all model matrices are
+// streamed into an instance buffer every frame. The vertex shader reads its model matrix from a vertex attribute
+// that only advances once per instance (glVertexAttribDivisor), so one glDrawArraysInstanced draws every object.
+class InstancedRenderer
+{
+public:
+	// Vertex attribute location of the per-instance model matrix. A mat4 attribute occupies 4 consecutive locations (one per column).
+	static const unsigned int ModelAttribute = 2;
+
+	// Ring buffer the model matrices are streamed through, with room for Capacity matrices per frame.
+	StreamBuffer Instances;
+
+	// Number of model matrices the instance buffer can hold per frame, and the number of instances to draw.
+	int Capacity;
+	int Count;
+
+	InstancedRenderer() : Capacity(0), Count(0), vao(0), models(NULL)
+	{
+	}
+
+	// Create the instance buffer and hook it up to the mesh's vertex array object.
+	void create(unsigned int meshVAO, int capacity, bool allowPersistentMapping = true)
+	{
+		vao = meshVAO;
+		Capacity = capacity;
+
+		Instances.create(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * sizeof(glm::mat4), allowPersistentMapping);
+
+		// A vertex attribute can be at most a vec4, so the matrix is split up into its 4 columns.
+		// A divisor of 1 tells OpenGL to advance the attribute once per instance, rather than once per vertex.
+		// Where the matrices start changes every frame, so the attribute pointers are set in map(), once the frame's offset is known.
+		renderState().bindVertexArray(vao);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(ModelAttribute + column);
+			glVertexAttribDivisor(ModelAttribute + column, 1);
+		}
+		renderState().bindVertexArray(0);
+	}
+
+	// Reserve room for this frame's model matrices, up to Capacity of them (Count tells how many). Write them straight into the returned
+	// array, then call unmap() before drawing. Returns NULL when there's nothing to write, and draws then draw no instances.
+	glm::mat4* map(int count)
+	{
+		Count = count < Capacity ? count : Capacity;
+
+		GLintptr offset = 0;
+		models = (glm::mat4*)Instances.map((GLsizeiptr)Count * sizeof(glm::mat4), sizeof(glm::mat4), offset);
+		if (!models)
+		{
+			Count = 0;
+			return NULL;
+		}
+
+		// Point the attribute at this frame's matrices. GL_ARRAY_BUFFER is still bound by the stream buffer.
+		renderState().bindVertexArray(vao);
+		for (unsigned int column = 0; column < 4; column++)
+			glVertexAttribPointer(ModelAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+		return models;
+	}
+
+	void unmap()
+	{
+		if (models)
+			Instances.unmap();
+		models = NULL;
+	}
+
+	// Upload the model matrices of this frame from an array.
+	void update(const glm::mat4* source, int count)
+	{
+		glm::mat4* destination = map(count);
+		if (!destination)
+			return;
+
+		memcpy(destination, source, (size_t)Count * sizeof(glm::mat4));
+		unmap();
+	}
+
+	// Draw all instances with a single draw call.
+	void draw(int vertexCount) const
+	{
+		renderState().bindVertexArray(vao);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, Count);
+	}
+
+	// Draw all instances of an indexed mesh (the VAO's element buffer) with a single draw call.
+	void drawIndexed(int indexCount, GLenum indexType = GL_UNSIGNED_INT) const
+	{
+		renderState().bindVertexArray(vao);
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, Count);
+	}
+
+	// Call once the frame's draws are issued, so the instance buffer knows when the GPU is done with this frame's matrices.
+	void endFrame()
+	{
+		Instances.endFrame();
+	}
+
+private:
+	unsigned int vao;
+	glm::mat4* models;
+};
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+typedef void (*JobFunction)(void* data);
+
+// A unit of work. Jobs are small and never allocate: they point at their function and data, and (for parallelFor) at a range of items.
+struct Job
+{
+	void (*Execute)(JobSystem& system, Job& job);
+	JobFunction Function;
+	const void* Data;
+	size_t Begin, End, Grain;
+	JobCounter* Counter;
+	bool Heap;
+	std::atomic<bool> InUse;
+
+	Job() : Execute(NULL), Function(NULL), Data(NULL), Begin(0), End(0), Grain(0), Counter(NULL), Heap(false), InUse(false)
+	{
+	}
+};
+
+// Counts the jobs of a batch that haven't finished yet. Waiting on a counter waits for the whole batch, and jobs can depend on a
+// counter: they're only started once it reaches zero.
+class JobCounter
+{
+public:
+	JobCounter() : pending(0)
+	{
+	}
+
+	bool done() const
+	{
+		return pending.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> pending;
+
+	// The jobs waiting for this counter to reach zero. The last job of the batch reaches zero while holding the mutex.
+	std::mutex mutex;
+	std::vector<Job*> continuations;
+
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+};
+
+// A fixed size work-stealing deque of jobs (Chase and Lev, "Dynamic Circular Work-Stealing Deque", with the memory orders of
+// Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The thread owning the deque pushes and pops jobs at the bottom, like a stack, without any locks: the jobs it spawned last are the
+// ones whose data is still in its cache. Other threads steal from the top, the oldest jobs, which for a split range are the biggest.
+// Only taking the last job needs an atomic compare and swap, to settle a race between the owner and a thief.
+class WorkStealingDeque
+{
+public:
+	static const int64_t Capacity = 4096;
+
+	WorkStealingDeque() : top(0), bottom(0)
+	{
+		for (int64_t i = 0; i < Capacity; i++)
+			jobs[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	// Owner only. Returns false when the deque is full.
+	bool push(Job* job)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= Capacity)
+			return false;
+
+		// Publish the job (and everything written to it) to thieves, which read bottom with acquire.
+		jobs[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only.
+	Job* pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// Empty.
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+
+		Job* job = jobs[b & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// The last job: a thief may be taking it at the same time.
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = NULL;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread.
+	Job* steal()
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return NULL;
+
+		Job* job = jobs[t & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return NULL;
+		return job;
+	}
+
+	bool empty() const
+	{
+		return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+	}
+
+private:
+	// Owner and thieves write different ends, so keep them on different cache lines. (Padding rather than alignas: before C++17,
+	// new doesn't have to honor alignments beyond the fundamental one.)
+	std::atomic<int64_t> top;
+	char topPadding[64];
+	std::atomic<int64_t> bottom;
+	char bottomPadding[64];
+	std::atomic<Job*> jobs[Capacity];
+};
+
+// A fixed pool of worker threads running jobs, for work that can be split up: culling, transform updates, decoding, mesh processing.
+// Every worker has its own deque of jobs. Jobs spawned by a worker go onto its own deque, and a worker that runs out of jobs steals
+// from a random other worker, so the work spreads over the threads without any shared queue everyone contends on. The thread creating
+// the job system is worker 0, and runs jobs too whenever it waits for a counter. Other threads can submit jobs, through a locked queue.
+// Idle workers spin for a little while, then sleep until new jobs are submitted.
+class JobSystem
+{
+public:
+	static const size_t JobsPerThread = 4096;
+
+	// Create a job system using threadCount threads in total (including the calling thread), or one per core when threadCount is 0.
+	explicit JobSystem(int threadCount = 0) : stopping(false), epoch(0), sleeping(0), injectedCount(0)
+	{
+		if (threadCount <= 0)
+			threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+		for (int i = 0; i < threadCount; i++)
+			workers.push_back(std::unique_ptr<Worker>(new Worker(i)));
+
+		threadState().System = this;
+		threadState().Self = workers[0].get();
+		for (int i = 1; i < threadCount; i++)
+			workers[i]->Thread = std::thread(&JobSystem::workerMain, this, workers[i].get());
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (size_t i = 1; i < workers.size(); i++)
+			workers[i]->Thread.join();
+
+		if (threadState().System == this)
+			threadState() = ThreadState();
+	}
+
+	int threadCount() const
+	{
+		return (int)workers.size();
+	}
+
+	// Run function(data) on any thread. The job is counted by counter (if any) until it finished, and only starts once dependency
+	// (if any) reached zero. data has to stay valid until the job ran.
+	void run(JobFunction function, void* data, JobCounter* counter = NULL, JobCounter* dependency = NULL)
+	{
+		spawn(&JobSystem::executeFunction, function, data, 0, 0, 0, counter, dependency);
+	}
+
+	// Call body(begin, end) for consecutive ranges covering [first, last), on all threads, without waiting: counter reaches zero once
+	// every item has been processed, and nothing starts before dependency (if any) reached zero. body has to outlive the wait for counter.
+	// The range is split adaptively (lazy binary splitting): a thread processes its range in chunks of grain items, and only hands
+	// half of what's left to the other threads when its own deque ran dry, i.e. when the thieves have nothing else to take.
+	// Evenly loaded threads hardly split at all, while a thread stuck with expensive items keeps giving away work.
+	// A grain of 0 picks one that keeps the per-chunk overhead small.
+	template <typename Body>
+	void parallelFor(size_t first, size_t last, size_t grain, const Body& body, JobCounter& counter, JobCounter* dependency = NULL)
+	{
+		if (first >= last)
+			return;
+		if (grain == 0)
+			grain = std::max((last - first) / (workers.size() * 64), (size_t)1);
+		spawn(&JobSystem::executeRange<Body>, NULL, &body, first, last, grain, &counter, dependency);
+	}
+
+	// Call body(begin, end) for consecutive ranges covering [first, last), on all threads, and wait until they're done.
+	template <typename Body>
+	void parallelFor(size_t first, size_t last, size_t grain, const Body& body)
+	{
+		JobCounter counter;
+		parallelFor(first, last, grain, body, counter);
+		wait(counter);
+	}
+
+	// Wait until the counter reaches zero. Workers run jobs in the meantime, other threads just yield.
+	void wait(JobCounter& counter)
+	{
+		Worker* self = currentWorker();
+		while (!counter.done())
+		{
+			Job* job = self ? findJob(self) : NULL;
+			if (job)
+				execute(job);
+			else
+				std::this_thread::yield();
+		}
+
+		// The last job may still be holding the counter's mutex, don't let the caller destroy it under its feet.
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	// Jobs run and stolen since the job system was created, over all threads.
+	uint64_t executed() const
+	{
+		uint64_t count = 0;
+		for (size_t i = 0; i < workers.size(); i++)
+			count += workers[i]->Executed.load(std::memory_order_relaxed);
+		return count;
+	}
+
+	uint64_t stolen() const
+	{
+		uint64_t count = 0;
+		for (size_t i = 0; i < workers.size(); i++)
+			count += workers[i]->Stolen.load(std::memory_order_relaxed);
+		return count;
+	}
+
+private:
+	struct Worker
+	{
+		int Index;
+		WorkStealingDeque Deque;
+		std::unique_ptr<Job[]> Jobs;
+		size_t NextJob;
+		uint32_t Random;
+		std::atomic<uint64_t> Executed;
+		std::atomic<uint64_t> Stolen;
+		std::thread Thread;
+
+		explicit Worker(int index) : Index(index), Jobs(new Job[JobsPerThread]), NextJob(0), Random(2463534242u + index * 7919u), Executed(0), Stolen(0)
+		{
+		}
+	};
+
+	// The worker running on the current thread, if it belongs to this job system.
+	struct ThreadState
+	{
+		JobSystem* System;
+		Worker* Self;
+
+		ThreadState() : System(NULL), Self(NULL)
+		{
+		}
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	bool stopping;
+
+	// Sleeping workers wait for the epoch to change, which every submitted job does.
+	std::atomic<uint64_t> epoch;
+	std::atomic<int> sleeping;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	// Jobs submitted by threads that aren't workers.
+	std::mutex injectedMutex;
+	std::deque<Job*> injected;
+	std::atomic<int> injectedCount;
+
+	static ThreadState& threadState()
+	{
+		static thread_local ThreadState state;
+		return state;
+	}
+
+	Worker* currentWorker()
+	{
+		return threadState().System == this ? threadState().Self : NULL;
+	}
+
+	// Take a job from the job ring of the current worker, or from the heap for other threads. Returns NULL when the ring is full of
+	// jobs that haven't run yet.
+	Job* allocate(Worker* self)
+	{
+		if (!self)
+		{
+			Job* job = new Job();
+			job->Heap = true;
+			return job;
+		}
+
+		Job& job = self->Jobs[self->NextJob++ % JobsPerThread];
+		if (job.InUse.load(std::memory_order_acquire))
+			return NULL;
+		job.InUse.store(true, std::memory_order_relaxed);
+		return &job;
+	}
+
+	void spawn(void (*executeJob)(JobSystem&, Job&), JobFunction function, const void* data, size_t begin, size_t end, size_t grain,
+		JobCounter* counter, JobCounter* dependency)
+	{
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+		Worker* self = currentWorker();
+		Job* job = allocate(self);
+		Job local;
+		if (!job)
+			job = &local;
+
+		job->Execute = executeJob;
+		job->Function = function;
+		job->Data = data;
+		job->Begin = begin;
+		job->End = end;
+		job->Grain = grain;
+		job->Counter = counter;
+
+		if (job == &local)
+		{
+			// Too many jobs in flight: run this one right here.
+			if (dependency)
+				wait(*dependency);
+			local.Execute(*this, local);
+			if (counter)
+				finish(counter);
+			return;
+		}
+
+		if (dependency)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (!dependency->done())
+			{
+				dependency->continuations.push_back(job);
+				return;
+			}
+		}
+		submit(self, job);
+	}
+
+	void submit(Worker* self, Job* job)
+	{
+		if (!self || !self->Deque.push(job))
+		{
+			std::lock_guard<std::mutex> lock(injectedMutex);
+			injected.push_back(job);
+			injectedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		epoch.fetch_add(1, std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_seq_cst) > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wake.notify_one();
+		}
+	}
+
+	Job* findJob(Worker* self)
+	{
+		Job* job = self->Deque.pop();
+		if (job)
+			return job;
+
+		if (injectedCount.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(injectedMutex);
+			if (!injected.empty())
+			{
+				job = injected.front();
+				injected.pop_front();
+				injectedCount.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		// Try every other worker, starting at a random one so the thieves don't all pick on the same victim.
+		self->Random ^= self->Random << 13;
+		self->Random ^= self->Random >> 17;
+		self->Random ^= self->Random << 5;
+		size_t start = self->Random % workers.size();
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			Worker* victim = workers[(start + i) % workers.size()].get();
+			if (victim == self)
+				continue;
+
+			job = victim->Deque.steal();
+			if (job)
+			{
+				self->Stolen.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		return NULL;
+	}
+
+	void execute(Job* job)
+	{
+		job->Execute(*this, *job);
+
+		Worker* self = currentWorker();
+		if (self)
+			self->Executed.fetch_add(1, std::memory_order_relaxed);
+
+		// The job is done with, so its slot can be reused before the counter lets anyone move on.
+		JobCounter* counter = job->Counter;
+		if (job->Heap)
+			delete job;
+		else
+			job->InUse.store(false, std::memory_order_release);
+		if (counter)
+			finish(counter);
+	}
+
+	void finish(JobCounter* counter)
+	{
+		int pending = counter->pending.load(std::memory_order_relaxed);
+		while (pending > 1)
+		{
+			if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+				return;
+		}
+
+		// Possibly the last job of the batch: reach zero while holding the mutex, so no continuation gets added after we took them.
+		std::vector<Job*> ready;
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				ready.swap(counter->continuations);
+		}
+
+		Worker* self = currentWorker();
+		for (size_t i = 0; i < ready.size(); i++)
+			submit(self, ready[i]);
+	}
+
+	static void executeFunction(JobSystem&, Job& job)
+	{
+		job.Function(const_cast<void*>(job.Data));
+	}
+
+	template <typename Body>
+	static void executeRange(JobSystem& system, Job& job)
+	{
+		const Body& body = *(const Body*)job.Data;
+		Worker* self = system.currentWorker();
+		size_t begin = job.Begin, end = job.End;
+		while (begin < end)
+		{
+			if (self && end - begin > 2 * job.Grain && self->Deque.empty())
+			{
+				size_t middle = begin + (end - begin) / 2;
+				system.spawn(&JobSystem::executeRange<Body>, NULL, &body, middle, end, job.Grain, job.Counter, NULL);
+				end = middle;
+				continue;
+			}
+
+			size_t chunkEnd = std::min(begin + job.Grain, end);
+			body(begin, chunkEnd);
+			begin = chunkEnd;
+		}
+	}
+
+	void workerMain(Worker* self)
+	{
+		threadState().System = this;
+		threadState().Self = self;
+
+		while (true)
+		{
+			uint64_t seen = epoch.load(std::memory_order_seq_cst);
+			Job* job = findJob(self);
+			for (int spin = 0; !job && spin < 64; spin++)
+			{
+				std::this_thread::yield();
+				job = findJob(self);
+			}
+			if (job)
+			{
+				execute(job);
+				continue;
+			}
+
+			// Nothing to do: sleep until a job is submitted after we last looked.
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleeping.fetch_add(1, std::memory_order_seq_cst);
+			wake.wait(lock, [&] { return stopping || epoch.load(std::memory_order_seq_cst) != seen; });
+			sleeping.fetch_sub(1, std::memory_order_seq_cst);
+			if (stopping)
+				return;
+		}
+	}
+
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+};
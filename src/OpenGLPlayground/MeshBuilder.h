@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// An indexed triangle mesh: interleaved float vertices (Stride floats per vertex) and 3 indices per triangle.
+struct IndexedMesh
+{
+	std::vector<float> Vertices;
+	std::vector<unsigned int> Indices;
+	int Stride;
+
+	IndexedMesh() : Stride(0)
+	{
+	}
+
+	size_t vertexCount() const
+	{
+		return Stride ? Vertices.size() / Stride : 0;
+	}
+};
+
+// How well an index buffer uses the GPU's post-transform vertex cache.
+// After the vertex shader ran for a vertex, its output is kept in a small cache. If an index refers to a vertex still in the cache,
+// the vertex shader doesn't have to run again. The cache is simulated as a FIFO, which is how most hardware behaves.
+//	- ACMR (average cache miss ratio): vertex shader invocations per triangle. 3.0 is the worst case, ~0.5 the best possible for regular meshes.
+//	- ATVR (average transformed vertex ratio): vertex shader invocations per unique vertex. 1.0 is the best possible.
+struct VertexCacheStatistics
+{
+	float ACMR;
+	float ATVR;
+
+	static VertexCacheStatistics analyze(const unsigned int* indices, size_t indexCount, size_t vertexCount, int cacheSize = 16)
+	{
+		std::vector<bool> inCache(vertexCount, false);
+		std::deque<unsigned int> cache;
+		size_t misses = 0;
+
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			unsigned int index = indices[i];
+			if (inCache[index])
+				continue;
+
+			misses++;
+			cache.push_back(index);
+			inCache[index] = true;
+			if ((int)cache.size() > cacheSize)
+			{
+				inCache[cache.front()] = false;
+				cache.pop_front();
+			}
+		}
+
+		VertexCacheStatistics stats;
+		stats.ACMR = indexCount ? (float)misses / (indexCount / 3) : 0.0f;
+		stats.ATVR = vertexCount ? (float)misses / vertexCount : 0.0f;
+		return stats;
+	}
+};
+
+// Offline helpers that turn a plain triangle list into an indexed mesh, optimized for the GPU's vertex caches.
+namespace MeshBuilder
+{
+	// Turn a non-indexed triangle list into an indexed mesh, welding bitwise identical vertices into one.
+	// Uses an open addressing hash table over the raw vertex bytes, so it's linear in the number of vertices.
+	inline IndexedMesh weld(const float* vertices, size_t vertexCount, int stride)
+	{
+		IndexedMesh mesh;
+		mesh.Stride = stride;
+		mesh.Indices.reserve(vertexCount);
+
+		const size_t vertexSize = stride * sizeof(float);
+		size_t tableSize = 1;
+		while (tableSize < vertexCount * 2)
+			tableSize <<= 1;
+		std::vector<unsigned int> table(tableSize, 0xFFFFFFFFu);
+
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const float* vertex = vertices + i * stride;
+
+			// FNV-1a hash of the vertex bytes.
+			uint32_t hash = 2166136261u;
+			const unsigned char* bytes = (const unsigned char*)vertex;
+			for (size_t b = 0; b < vertexSize; b++)
+				hash = (hash ^ bytes[b]) * 16777619u;
+
+			size_t slot = hash & (tableSize - 1);
+			while (table[slot] != 0xFFFFFFFFu && memcmp(&mesh.Vertices[table[slot] * stride], vertex, vertexSize) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == 0xFFFFFFFFu)
+			{
+				table[slot] = (unsigned int)mesh.vertexCount();
+				mesh.Vertices.insert(mesh.Vertices.end(), vertex, vertex + stride);
+			}
+			mesh.Indices.push_back(table[slot]);
+		}
+
+		return mesh;
+	}
+
+	// Reorder the triangles for the post-transform vertex cache, using Tipsify
+	// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+	// Triangles are emitted as fans around a vertex, and the next fan vertex is picked among the vertices just emitted,
+	// preferring the ones that will still be in a cache of cacheSize entries once their remaining triangles are emitted.
+	inline void optimizeVertexCache(IndexedMesh& mesh, int cacheSize = 16)
+	{
+		const size_t vertexCount = mesh.vertexCount();
+		const size_t triangleCount = mesh.Indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Vertex-triangle adjacency, stored as offsets into a single array.
+		std::vector<unsigned int> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < mesh.Indices.size(); i++)
+			liveTriangles[mesh.Indices[i]]++;
+
+		std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+		std::vector<unsigned int> adjacency(mesh.Indices.size());
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[mesh.Indices[t * 3 + k]]++] = (unsigned int)t;
+
+		std::vector<int> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> deadEnds;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(mesh.Indices.size());
+
+		int timestamp = cacheSize + 1;
+		size_t cursor = 1;
+		long long fanning = 0;
+
+		while (fanning >= 0)
+		{
+			// Emit all remaining triangles around the fanning vertex.
+			candidates.clear();
+			for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+			{
+				unsigned int t = adjacency[a];
+				if (emitted[t])
+					continue;
+
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = mesh.Indices[t * 3 + k];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (timestamp - cacheTime[v] > cacheSize)
+						cacheTime[v] = timestamp++;
+				}
+				emitted[t] = true;
+			}
+
+			// Pick the next fanning vertex: the candidate that has been in the cache the longest,
+			// as long as its remaining triangles won't push it out of the cache.
+			long long next = -1;
+			int bestPriority = -1;
+			for (size_t c = 0; c < candidates.size(); c++)
+			{
+				unsigned int v = candidates[c];
+				if (liveTriangles[v] == 0)
+					continue;
+
+				int priority = 0;
+				if (timestamp - cacheTime[v] + 2 * (int)liveTriangles[v] <= cacheSize)
+					priority = timestamp - cacheTime[v];
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			// Dead end: fall back to the most recently emitted vertex with triangles left, or else scan for any such vertex.
+			while (next == -1 && !deadEnds.empty())
+			{
+				unsigned int v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0)
+					next = v;
+			}
+			while (next == -1 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					next = (long long)cursor;
+				cursor++;
+			}
+
+			fanning = next;
+		}
+
+		mesh.Indices.swap(output);
+	}
+
+	// Reorder the vertices in the order the index buffer first references them, so vertex fetching walks through memory linearly.
+	// Run after optimizeVertexCache, as it depends on the final triangle order.
+	inline void optimizeVertexFetch(IndexedMesh& mesh)
+	{
+		const size_t vertexCount = mesh.vertexCount();
+		std::vector<unsigned int> remap(vertexCount, 0xFFFFFFFFu);
+		std::vector<float> vertices;
+		vertices.reserve(mesh.Vertices.size());
+
+		unsigned int next = 0;
+		for (size_t i = 0; i < mesh.Indices.size(); i++)
+		{
+			unsigned int& index = mesh.Indices[i];
+			if (remap[index] == 0xFFFFFFFFu)
+			{
+				remap[index] = next++;
+				vertices.insert(vertices.end(), mesh.Vertices.begin() + index * mesh.Stride, mesh.Vertices.begin() + (index + 1) * mesh.Stride);
+			}
+			index = remap[index];
+		}
+
+		// Vertices not referenced by any triangle are dropped.
+		mesh.Vertices.swap(vertices);
+	}
+}
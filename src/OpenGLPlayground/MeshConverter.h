@@ -0,0 +1,161 @@
+#pragma once
+
+#include "MeshBuilder.h"
+#include "MeshFile.h"
+#include "VertexFormat.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Offline conversion of text meshes into the binary mesh format (MeshFile.h).
+// All the slow work happens here, once: parsing the text, triangulating the faces, welding the vertices and optimizing
+// them for the vertex caches. The runtime loader only maps the result.
+namespace MeshConverter
+{
+	// Resolve an OBJ index (1-based, or negative to count back from the last element read so far) into a 0-based index.
+	inline bool resolveObjIndex(const std::string& token, size_t count, size_t& index)
+	{
+		if (token.empty())
+			return false;
+
+		long value = strtol(token.c_str(), NULL, 10);
+		if (value > 0 && (size_t)value <= count)
+			index = (size_t)value - 1;
+		else if (value < 0 && (size_t)-value <= count)
+			index = count - (size_t)-value;
+		else
+			return false;
+		return true;
+	}
+
+	// Convert a Wavefront OBJ file into a mesh file with vertices in the given format.
+	// Vertices get a position, texture coordinates and, when the file has any, a normal. Polygons are triangulated as fans,
+	// and every face corner becomes a vertex that's welded with its identical copies afterwards. Groups, objects and materials are ignored.
+	inline bool convertObj(const std::string& inputPath, const std::string& outputPath, const VertexFormat& format, std::ostream& out)
+	{
+		std::ifstream file(inputPath.c_str());
+		if (!file)
+		{
+			std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_READ " << inputPath << std::endl;
+			return false;
+		}
+
+		std::vector<float> positions, texCoords, normals;
+		struct Corner
+		{
+			size_t Position, TexCoord, Normal;
+			bool HasTexCoord, HasNormal;
+		};
+		std::vector<Corner> corners;
+		bool anyNormals = false;
+
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			std::istringstream stream(line);
+			std::string keyword;
+			stream >> keyword;
+
+			if (keyword == "v" || keyword == "vn")
+			{
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				stream >> x >> y >> z;
+				std::vector<float>& target = keyword == "v" ? positions : normals;
+				target.push_back(x);
+				target.push_back(y);
+				target.push_back(z);
+			}
+			else if (keyword == "vt")
+			{
+				float u = 0.0f, v = 0.0f;
+				stream >> u >> v;
+				texCoords.push_back(u);
+				texCoords.push_back(v);
+			}
+			else if (keyword == "f")
+			{
+				// Every corner is position/texcoord/normal, where texcoord and normal are optional (v, v/vt, v//vn or v/vt/vn).
+				std::vector<Corner> polygon;
+				std::string token;
+				while (stream >> token)
+				{
+					std::string fields[3];
+					size_t start = 0;
+					for (int field = 0; field < 3; field++)
+					{
+						size_t slash = token.find('/', start);
+						fields[field] = token.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+						if (slash == std::string::npos)
+							break;
+						start = slash + 1;
+					}
+
+					Corner corner;
+					corner.Position = corner.TexCoord = corner.Normal = 0;
+					corner.HasTexCoord = !fields[1].empty();
+					corner.HasNormal = !fields[2].empty();
+					if (!resolveObjIndex(fields[0], positions.size() / 3, corner.Position)
+						|| (corner.HasTexCoord && !resolveObjIndex(fields[1], texCoords.size() / 2, corner.TexCoord))
+						|| (corner.HasNormal && !resolveObjIndex(fields[2], normals.size() / 3, corner.Normal)))
+					{
+						std::cout << "ERROR::MESH::INVALID_FACE " << inputPath << ":" << lineNumber << std::endl;
+						return false;
+					}
+					anyNormals = anyNormals || corner.HasNormal;
+					polygon.push_back(corner);
+				}
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					corners.push_back(polygon[0]);
+					corners.push_back(polygon[i - 1]);
+					corners.push_back(polygon[i]);
+				}
+			}
+		}
+
+		if (corners.empty())
+		{
+			std::cout << "ERROR::MESH::NO_TRIANGLES " << inputPath << std::endl;
+			return false;
+		}
+
+		// Build the triangle list in the vertex layout of the file: position, texture coordinates, normal.
+		const int stride = anyNormals ? 8 : 5;
+		std::vector<float> vertices;
+		vertices.reserve(corners.size() * stride);
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			const Corner& corner = corners[i];
+			vertices.insert(vertices.end(), &positions[3 * corner.Position], &positions[3 * corner.Position] + 3);
+			vertices.push_back(corner.HasTexCoord ? texCoords[2 * corner.TexCoord] : 0.0f);
+			vertices.push_back(corner.HasTexCoord ? texCoords[2 * corner.TexCoord + 1] : 0.0f);
+			if (anyNormals)
+			{
+				for (int axis = 0; axis < 3; axis++)
+					vertices.push_back(corner.HasNormal ? normals[3 * corner.Normal + axis] : 0.0f);
+			}
+		}
+
+		IndexedMesh mesh = MeshBuilder::weld(vertices.data(), corners.size(), stride);
+		MeshBuilder::optimizeVertexCache(mesh);
+		MeshBuilder::optimizeVertexFetch(mesh);
+
+		PackedVertices packed;
+		if (!format.compile(mesh, packed, &out))
+			return false;
+		if (!MeshFile::write(outputPath, packed, mesh.Indices))
+			return false;
+
+		out << "Converted " << inputPath << " -> " << outputPath << ": " << corners.size() / 3 << " triangles, "
+			<< mesh.vertexCount() << " vertices (" << packed.Stride << " bytes each), "
+			<< (mesh.vertexCount() <= 0x10000 ? 16 : 32) << "-bit indices" << std::endl;
+		return true;
+	}
+}
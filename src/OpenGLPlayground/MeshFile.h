@@ -0,0 +1,362 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "VertexFormat.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only into memory.
+// Reading the file would copy every byte from the OS page cache into a buffer of ours first. Mapping it makes the page cache
+// itself show up in our address space, so the data is only copied once, by whoever reads it (here: the driver, into the buffer object).
+class MappedFile
+{
+public:
+	const unsigned char* Data;
+	size_t Size;
+
+	MappedFile() : Data(NULL), Size(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#endif
+	}
+
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		Data = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (!Data)
+		{
+			close();
+			return false;
+		}
+		Size = (size_t)size.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps the file alive, the descriptor isn't needed anymore.
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+
+		// The whole file is read front to back once, so ask the kernel to read ahead aggressively.
+		madvise(data, (size_t)status.st_size, MADV_SEQUENTIAL);
+		madvise(data, (size_t)status.st_size, MADV_WILLNEED);
+		Data = (const unsigned char*)data;
+		Size = (size_t)status.st_size;
+#endif
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (Data)
+			UnmapViewOfFile(Data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		if (Data)
+			munmap((void*)Data, Size);
+#endif
+		Data = NULL;
+		Size = 0;
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+// The header at the start of a mesh file. All fields are little endian, like every platform the playground runs on.
+struct MeshFileHeader
+{
+	static const int MaxAttributes = 8;
+
+	char Magic[4];
+	uint32_t Version;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t Stride;
+	uint32_t IndexType;
+	uint32_t AttributeCount;
+	uint32_t Reserved;
+
+	// Where the blobs are, in bytes from the start of the file.
+	uint64_t VertexOffset;
+	uint64_t VertexSize;
+	uint64_t IndexOffset;
+	uint64_t IndexSize;
+
+	MeshAttribute Attributes[MaxAttributes];
+};
+
+static_assert(sizeof(MeshFileHeader) == 256, "the mesh file header is read straight from the file");
+
+// A binary mesh file, laid out so it can be drawn without being parsed:
+//
+//	| header (256 bytes) | padding | vertex blob | padding | index blob |
+//
+// The vertex blob holds the interleaved vertices exactly as the vertex buffer should contain them (in any vertex format, see
+// VertexFormat.h), and the index blob the index buffer (16-bit indices when the mesh has few enough vertices, 32-bit otherwise). The header describes the attribute layout, so
+// loading a mesh is mapping the file, checking the header and handing the two blobs to glBufferData. There's no parsing, and the
+// only copy is the one the driver makes into the buffer object.
+// The blobs start on a page boundary, so they could also be mapped on their own, or read with unbuffered I/O.
+// Meshes are converted to this format offline, see MeshConverter.h.
+class MeshFile
+{
+public:
+	static const uint32_t Version = 1;
+	static const uint64_t BlobAlignment = 4096;
+
+	MappedFile File;
+	const MeshFileHeader* Header;
+
+	MeshFile() : Header(NULL)
+	{
+	}
+
+	// Map a mesh file and check its header.
+	bool open(const std::string& path)
+	{
+		close();
+		if (!File.open(path))
+		{
+			std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+			return false;
+		}
+
+		const MeshFileHeader* header = (const MeshFileHeader*)File.Data;
+		if (File.Size < sizeof(MeshFileHeader) || memcmp(header->Magic, "PGMS", 4) != 0 || header->Version != Version)
+		{
+			std::cout << "ERROR::MESH::NOT_A_MESH_FILE " << path << std::endl;
+			close();
+			return false;
+		}
+
+		// The header is all the validation a mesh file gets, so nothing in it may point outside the file or make OpenGL read past a
+		// vertex. The blob checks are written so they can't overflow, whatever the offsets and sizes are.
+		const uint64_t indexSize = header->IndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+		if (header->AttributeCount > MeshFileHeader::MaxAttributes
+			|| (header->IndexType != GL_UNSIGNED_SHORT && header->IndexType != GL_UNSIGNED_INT)
+			|| header->VertexSize != (uint64_t)header->VertexCount * header->Stride
+			|| header->IndexSize != (uint64_t)header->IndexCount * indexSize
+			|| !insideFile(header->VertexOffset, header->VertexSize)
+			|| !insideFile(header->IndexOffset, header->IndexSize)
+			|| !validAttributes(*header))
+		{
+			std::cout << "ERROR::MESH::CORRUPT_HEADER " << path << std::endl;
+			close();
+			return false;
+		}
+
+		Header = header;
+		return true;
+	}
+
+	void close()
+	{
+		File.close();
+		Header = NULL;
+	}
+
+	// The blobs, ready to be passed to glBufferData.
+	const void* vertices() const
+	{
+		return File.Data + Header->VertexOffset;
+	}
+
+	const void* indices() const
+	{
+		return File.Data + Header->IndexOffset;
+	}
+
+	// Point the vertex attributes of the bound vertex array at the vertex buffer bound to GL_ARRAY_BUFFER.
+	void setAttributePointers() const
+	{
+		setVertexAttributes(Header->Attributes, Header->AttributeCount, (GLsizei)Header->Stride);
+	}
+
+	// Write a mesh: its vertices, compiled into their vertex format, and 3 indices per triangle.
+	static bool write(const std::string& path, const PackedVertices& vertices, const std::vector<unsigned int>& indices)
+	{
+		const std::vector<MeshAttribute>& attributes = vertices.Attributes;
+		if (attributes.size() > MeshFileHeader::MaxAttributes)
+		{
+			std::cout << "ERROR::MESH::TOO_MANY_ATTRIBUTES " << attributes.size() << std::endl;
+			return false;
+		}
+
+		MeshFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.Magic, "PGMS", 4);
+		header.Version = Version;
+		header.VertexCount = (uint32_t)vertices.VertexCount;
+		header.IndexCount = (uint32_t)indices.size();
+		header.Stride = vertices.Stride;
+		header.AttributeCount = (uint32_t)attributes.size();
+		for (size_t i = 0; i < attributes.size(); i++)
+			header.Attributes[i] = attributes[i];
+
+		// 16-bit indices halve the index buffer, and are all most meshes need.
+		std::vector<uint16_t> shortIndices;
+		const void* indexData = indices.data();
+		header.IndexType = GL_UNSIGNED_INT;
+		header.IndexSize = indices.size() * sizeof(uint32_t);
+		if (vertices.VertexCount <= 0x10000)
+		{
+			shortIndices.assign(indices.begin(), indices.end());
+			indexData = shortIndices.data();
+			header.IndexType = GL_UNSIGNED_SHORT;
+			header.IndexSize = shortIndices.size() * sizeof(uint16_t);
+		}
+
+		header.VertexSize = vertices.Data.size();
+		header.VertexOffset = align(sizeof(header));
+		header.IndexOffset = align(header.VertexOffset + header.VertexSize);
+
+		std::ofstream file(path.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+
+		uint64_t position = 0;
+		writeBlob(file, position, 0, &header, sizeof(header));
+		writeBlob(file, position, header.VertexOffset, vertices.Data.data(), header.VertexSize);
+		writeBlob(file, position, header.IndexOffset, indexData, header.IndexSize);
+		if (!file)
+		{
+			std::cout << "ERROR::MESH::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	// Every OpenGL 3.3 implementation supports at least 16 vertex attributes.
+	static const uint32_t MaxAttributeLocation = 16;
+
+	MeshFile(const MeshFile&);
+	MeshFile& operator=(const MeshFile&);
+
+	bool insideFile(uint64_t offset, uint64_t size) const
+	{
+		return offset <= File.Size && size <= File.Size - offset;
+	}
+
+	// Every attribute has to be a type the vertex formats produce, at a location OpenGL supports, and lie within the vertex.
+	static bool validAttributes(const MeshFileHeader& header)
+	{
+		for (uint32_t i = 0; i < header.AttributeCount; i++)
+		{
+			const MeshAttribute& attribute = header.Attributes[i];
+			uint64_t size = attributeSize(attribute);
+			if (size == 0 || attribute.Location >= MaxAttributeLocation || (uint64_t)attribute.Offset + size > header.Stride)
+				return false;
+		}
+		return true;
+	}
+
+	// Bytes an attribute takes up in a vertex, or 0 if it isn't a valid attribute.
+	static uint64_t attributeSize(const MeshAttribute& attribute)
+	{
+		if (attribute.Components < 1 || attribute.Components > 4)
+			return 0;
+
+		switch (attribute.Type)
+		{
+		case GL_FLOAT:
+			return 4 * attribute.Components;
+		case GL_HALF_FLOAT:
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+			return 2 * attribute.Components;
+		case GL_INT_2_10_10_10_REV:
+			return attribute.Components == 4 ? 4 : 0;
+		default:
+			return 0;
+		}
+	}
+
+	static uint64_t align(uint64_t offset)
+	{
+		return (offset + BlobAlignment - 1) / BlobAlignment * BlobAlignment;
+	}
+
+	// Pad the file with zeros up to offset, then write the blob there.
+	static void writeBlob(std::ofstream& file, uint64_t& position, uint64_t offset, const void* data, uint64_t size)
+	{
+		static const char zeros[BlobAlignment] = {};
+		while (position < offset)
+		{
+			uint64_t padding = offset - position;
+			if (padding > BlobAlignment)
+				padding = BlobAlignment;
+			file.write(zeros, (std::streamsize)padding);
+			position += padding;
+		}
+		file.write((const char*)data, (std::streamsize)size);
+		position += size;
+	}
+};
@@ -0,0 +1,654 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "FrameArena.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// CPU-only benchmarks of individual engine systems, run without an OpenGL context.
+// They measure the systems with object counts far beyond what the cube scene draws, and compare optimized implementations
+// against their straightforward reference versions (which also double as a correctness check).
+namespace Microbenchmarks
+{
+	// Number of timed passes over all objects.
+	const int Passes = 60;
+
+	// Names of the built-in microbenchmarks:
+	//	- culling:	frustum culls the objects' bounding spheres with the scalar and the SIMD plane tests.
+	//	- sort:		sorts a draw packet per object by its render queue key with std::stable_sort and the radix sort, and checks the keys are in depth order.
+	//	- transforms:	builds the objects' model matrices one by one with glm and with the SIMD transform system.
+	//	- hierarchy:	animates vehicles made of 28 nodes each, stored as a tree of pointers and as a flat scene graph.
+	//	- jobs:		builds the model matrices and culls the objects with the job system, on 1 to 64 threads.
+	//	- arena:	builds a frame's draw list, matrices and batch table in containers on the heap and in a frame arena.
+	inline bool exists(const std::string& name)
+	{
+		return name == "culling" || name == "sort" || name == "transforms" || name == "hierarchy" || name == "jobs" || name == "arena";
+	}
+
+	// The view and projection matrix of every pass, taken from the flythrough camera script 10 frames apart.
+	inline std::vector<glm::mat4> flythroughViewProjections()
+	{
+		CameraScript script("flythrough");
+		std::vector<glm::mat4> viewProjections;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			CameraPose pose = script.evaluate(pass * 10);
+			glm::mat4 view = glm::lookAt(pose.Position, pose.Position + pose.Front, glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 projection = glm::perspective(glm::radians(pose.FOV), 800.0f / 600.0f, 0.1f, 100.0f);
+			viewProjections.push_back(projection * view);
+		}
+		return viewProjections;
+	}
+
+	// Cull the bounding spheres of objects at the given positions against the frustums of the flythrough camera script.
+	inline bool culling(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		BoundingSpheres spheres;
+		spheres.reserve(positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			spheres.push_back(positions[i], 0.8660254f);
+
+		// Every pass uses the frustum of another frame, so different objects end up visible.
+		std::vector<Frustum> frustums;
+		std::vector<glm::mat4> viewProjections = flythroughViewProjections();
+		for (int pass = 0; pass < Passes; pass++)
+			frustums.push_back(Frustum::fromMatrix(viewProjections[pass]));
+
+		FrustumCuller culler;
+		std::vector<unsigned int> reference, visible;
+		std::vector<float> referenceTimes, simdTimes;
+		long long visibleTotal = 0;
+		bool identical = true;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			culler.cullReference(frustums[pass], spheres, reference);
+			std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+			culler.cull(frustums[pass], spheres, visible);
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			referenceTimes.push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+			simdTimes.push_back(std::chrono::duration<float, std::milli>(end - middle).count());
+			visibleTotal += culler.Visible;
+			identical = identical && reference == visible;
+		}
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		const char* simd = "AVX, 8 wide";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		const char* simd = "SSE, 4 wide";
+#else
+		const char* simd = "not available, scalar";
+#endif
+
+		FrameStatistics referenceStats = FrameStatistics::compute(referenceTimes);
+		FrameStatistics simdStats = FrameStatistics::compute(simdTimes);
+		out << "Culling: " << positions.size() << " objects, " << Passes << " passes, "
+			<< visibleTotal / Passes << " visible per pass on average" << std::endl;
+		out << "  scalar ms: mean " << referenceStats.Mean << ", p50 " << referenceStats.P50 << ", max " << referenceStats.Max << std::endl;
+		out << "  simd   ms: mean " << simdStats.Mean << ", p50 " << simdStats.P50 << ", max " << simdStats.Max
+			<< " (" << simd << ", " << referenceStats.P50 / simdStats.P50 << "x)" << std::endl;
+
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::CULLING_RESULTS_DIFFER" << std::endl;
+		return identical;
+	}
+
+	// Check that the keys put draws in depth order, including at and beyond the near and far planes: opaque draws front to back,
+	// blended draws back to front. The sort benchmark only compares the two sorts on the same keys, which can't catch bad keys.
+	inline bool sortKeyOrder()
+	{
+		const float distances[] = { -10.0f, 0.1f, 0.2f, 50.0f, 99.9f, 100.0f, 150.0f, 1.0e6f };
+		const int count = sizeof(distances) / sizeof(distances[0]);
+		bool ordered = true;
+		for (int i = 1; i < count; i++)
+		{
+			unsigned int nearer = RenderQueue::depthBits(distances[i - 1], 0.1f, 100.0f);
+			unsigned int farther = RenderQueue::depthBits(distances[i], 0.1f, 100.0f);
+
+			// Distances up to the near plane, and from the far plane on, are clamped to the same depth. Everything in between is ordered strictly.
+			bool clamped = distances[i] <= 0.1f || distances[i - 1] >= 100.0f;
+			uint64_t opaqueNearer = RenderQueue::opaqueKey(OpaquePass, 1, 2, 3, nearer);
+			uint64_t opaqueFarther = RenderQueue::opaqueKey(OpaquePass, 1, 2, 3, farther);
+			uint64_t blendedNearer = RenderQueue::transparentKey(TransparentPass, nearer, 1, 2, 3);
+			uint64_t blendedFarther = RenderQueue::transparentKey(TransparentPass, farther, 1, 2, 3);
+			bool correct = clamped ? opaqueNearer == opaqueFarther && blendedNearer == blendedFarther
+				: opaqueNearer < opaqueFarther && blendedNearer > blendedFarther;
+			if (!correct)
+			{
+				std::cout << "ERROR::MICROBENCHMARK::SORT_KEYS_OUT_OF_DEPTH_ORDER at distances " << distances[i - 1] << " and " << distances[i] << std::endl;
+				ordered = false;
+			}
+		}
+		return ordered;
+	}
+
+	// Sort a draw packet per object, keyed like an opaque draw from the camera of another flythrough frame every pass.
+	// The objects are spread over a few programs, materials and vertex arrays, so the keys don't only differ in depth.
+	inline bool sort(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		CameraScript script("flythrough");
+		RenderQueue reference, queue;
+		reference.reserve(positions.size());
+		queue.reserve(positions.size());
+
+		std::vector<float> referenceTimes, radixTimes;
+		bool identical = true;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			CameraPose pose = script.evaluate(pass * 10);
+			reference.clear();
+			for (unsigned int i = 0; i < positions.size(); i++)
+			{
+				unsigned int depth = RenderQueue::depthBits(glm::dot(positions[i] - pose.Position, pose.Front), 0.1f, 100.0f);
+				reference.push(RenderQueue::opaqueKey(OpaquePass, i % 4, i % 64, i % 8, depth), i);
+			}
+			queue.Packets = reference.Packets;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			reference.sortReference();
+			std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+			queue.sort();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			referenceTimes.push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+			radixTimes.push_back(std::chrono::duration<float, std::milli>(end - middle).count());
+			for (size_t i = 0; i < queue.size() && identical; i++)
+				identical = queue.Packets[i].Key == reference.Packets[i].Key && queue.Packets[i].Object == reference.Packets[i].Object;
+		}
+
+		FrameStatistics referenceStats = FrameStatistics::compute(referenceTimes);
+		FrameStatistics radixStats = FrameStatistics::compute(radixTimes);
+		out << "Sort: " << positions.size() << " draw packets, " << Passes << " passes" << std::endl;
+		out << "  std::stable_sort ms: mean " << referenceStats.Mean << ", p50 " << referenceStats.P50 << ", max " << referenceStats.Max << std::endl;
+		out << "  radix sort       ms: mean " << radixStats.Mean << ", p50 " << radixStats.P50 << ", max " << radixStats.Max
+			<< " (" << referenceStats.P50 / radixStats.P50 << "x)" << std::endl;
+
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::SORT_RESULTS_DIFFER" << std::endl;
+		return sortKeyOrder() && identical;
+	}
+
+	// Rotate the objects at the given positions (around the axis the cubes use) and build their model matrices.
+	// Every pass either all objects move, or only one in a hundred, which is where the dirty bits pay off.
+	inline bool transforms(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		const glm::vec3 axis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+		TransformSystem reference, system;
+		reference.reserve(positions.size());
+		system.reserve(positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			glm::vec3 scale(1.0f + (i % 3) * 0.25f);
+			reference.add(positions[i], glm::angleAxis(glm::radians(20.0f * i), axis), scale);
+			system.add(positions[i], glm::angleAxis(glm::radians(20.0f * i), axis), scale);
+		}
+
+		std::vector<float> referenceTimes, simdTimes, partialTimes;
+		size_t partialUpdated = 0;
+		float maxError = 0.0f;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			for (unsigned int i = 0; i < positions.size(); i++)
+			{
+				glm::quat rotation = glm::angleAxis(glm::radians(20.0f * i + pass), axis);
+				reference.setRotation(i, rotation);
+				system.setRotation(i, rotation);
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			reference.updateReference();
+			std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+			system.update();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			referenceTimes.push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+			simdTimes.push_back(std::chrono::duration<float, std::milli>(end - middle).count());
+			for (size_t i = 0; i < positions.size(); i++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					glm::vec4 difference = glm::abs(reference.Matrices[i][c] - system.Matrices[i][c]);
+					maxError = glm::max(maxError, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+				}
+			}
+
+			// Move a scattered 1% of the objects (the reference moves them too, to compare the next pass).
+			for (unsigned int i = pass % 100; i < positions.size(); i += 100)
+			{
+				reference.setPosition(i, positions[i] + glm::vec3(0.0f, 0.01f * pass, 0.0f));
+				system.setPosition(i, positions[i] + glm::vec3(0.0f, 0.01f * pass, 0.0f));
+			}
+			start = std::chrono::steady_clock::now();
+			system.update();
+			end = std::chrono::steady_clock::now();
+			partialTimes.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+			partialUpdated += system.Updated;
+		}
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		const char* simd = "AVX, 8 wide";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		const char* simd = "SSE, 4 wide";
+#else
+		const char* simd = "not available, scalar";
+#endif
+
+		// Both paths round differently (the quaternion products are summed in another order), but must agree to a few ulps.
+		const bool identical = maxError <= 1e-5f;
+		FrameStatistics referenceStats = FrameStatistics::compute(referenceTimes);
+		FrameStatistics simdStats = FrameStatistics::compute(simdTimes);
+		FrameStatistics partialStats = FrameStatistics::compute(partialTimes);
+		out << "Transforms: " << positions.size() << " objects, " << Passes << " passes, max difference " << maxError << std::endl;
+		out << "  glm            ms: mean " << referenceStats.Mean << ", p50 " << referenceStats.P50 << ", max " << referenceStats.Max << std::endl;
+		out << "  simd           ms: mean " << simdStats.Mean << ", p50 " << simdStats.P50 << ", max " << simdStats.Max
+			<< " (" << simd << ", " << referenceStats.P50 / simdStats.P50 << "x)" << std::endl;
+		out << "  simd, 1% moved ms: mean " << partialStats.Mean << ", p50 " << partialStats.P50 << ", max " << partialStats.Max
+			<< " (" << partialUpdated / Passes << " matrices rebuilt per pass, " << referenceStats.P50 / partialStats.P50 << "x)" << std::endl;
+
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::TRANSFORMS_RESULTS_DIFFER" << std::endl;
+		return identical;
+	}
+
+	// A node of a hierarchy stored the straightforward way: every node allocated on its own, pointing to its children.
+	struct TreeNode
+	{
+		glm::vec3 Position;
+		glm::quat Rotation;
+		glm::mat4 Local;
+		glm::mat4 World;
+		bool Dirty;
+		std::vector<TreeNode*> Children;
+	};
+
+	// Update the world matrices of a subtree recursively, recomputing only the nodes that moved or whose parent moved.
+	inline size_t updateTree(TreeNode* node, const glm::mat4& parentWorld, bool parentMoved)
+	{
+		size_t updated = 0;
+		bool moved = parentMoved || node->Dirty;
+		if (node->Dirty)
+		{
+			node->Local = glm::translate(glm::mat4(1.0f), node->Position) * glm::mat4_cast(node->Rotation);
+			node->Dirty = false;
+		}
+		if (moved)
+		{
+			node->World = parentWorld * node->Local;
+			updated++;
+		}
+		for (size_t i = 0; i < node->Children.size(); i++)
+			updated += updateTree(node->Children[i], node->World, moved);
+		return updated;
+	}
+
+	// The parts of a vehicle, in depth-first order: a body with 4 wheels of 5 bolts each, and a turret holding a barrel and its muzzle.
+	struct VehiclePart
+	{
+		int Parent;
+		glm::vec3 Position;
+	};
+
+	inline std::vector<VehiclePart> vehicleParts(int& turret)
+	{
+		std::vector<VehiclePart> parts;
+		VehiclePart body = { -1, glm::vec3(0.0f) };
+		parts.push_back(body);
+		for (int wheel = 0; wheel < 4; wheel++)
+		{
+			VehiclePart part = { 0, glm::vec3(wheel % 2 ? 1.0f : -1.0f, -0.5f, wheel / 2 ? 1.5f : -1.5f) };
+			int wheelIndex = (int)parts.size();
+			parts.push_back(part);
+			for (int bolt = 0; bolt < 5; bolt++)
+			{
+				float angle = glm::radians(72.0f * bolt);
+				VehiclePart boltPart = { wheelIndex, glm::vec3(0.1f, 0.3f * cosf(angle), 0.3f * sinf(angle)) };
+				parts.push_back(boltPart);
+			}
+		}
+		turret = (int)parts.size();
+		VehiclePart turretPart = { 0, glm::vec3(0.0f, 0.6f, 0.0f) };
+		VehiclePart barrel = { turret, glm::vec3(0.0f, 0.2f, 1.0f) };
+		VehiclePart muzzle = { turret + 1, glm::vec3(0.0f, 0.0f, 1.0f) };
+		parts.push_back(turretPart);
+		parts.push_back(barrel);
+		parts.push_back(muzzle);
+		return parts;
+	}
+
+	// Animate a vehicle per 28 objects, placed at the objects' positions, both as a tree of pointers and as a flat scene graph.
+	// Every pass runs two scenes: driving, where every wheel spins and every 10th turret turns, and parked, where only 1% of the vehicles drive off.
+	inline bool hierarchy(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		int turret = 0;
+		const std::vector<VehiclePart> parts = vehicleParts(turret);
+		const size_t vehicleCount = glm::max(positions.size() / parts.size(), (size_t)1);
+		const glm::vec3 right(1.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f);
+
+		SceneGraph scene;
+		scene.reserve(vehicleCount * parts.size());
+		std::vector<TreeNode*> tree;
+		tree.reserve(vehicleCount * parts.size());
+		for (size_t v = 0; v < vehicleCount; v++)
+		{
+			size_t base = scene.size();
+			for (size_t p = 0; p < parts.size(); p++)
+			{
+				int parent = parts[p].Parent < 0 ? SceneGraph::NoParent : (int)base + parts[p].Parent;
+				glm::vec3 position = parts[p].Parent < 0 ? positions[v % positions.size()] : parts[p].Position;
+				scene.add(parent, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+				TreeNode* node = new TreeNode();
+				node->Position = position;
+				node->Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+				node->Dirty = true;
+				if (parent != SceneGraph::NoParent)
+					tree[parent]->Children.push_back(node);
+				tree.push_back(node);
+			}
+		}
+
+		std::vector<float> treeTimes[2], flatTimes[2];
+		size_t updated[2] = { 0, 0 };
+		float maxError = 0.0f;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			for (int parked = 0; parked < 2; parked++)
+			{
+				for (size_t v = parked ? pass % 100 : 0; v < vehicleCount; v += parked ? 100 : 1)
+				{
+					size_t base = v * parts.size();
+					if (parked)
+					{
+						glm::vec3 position = positions[v % positions.size()] + glm::vec3(0.0f, 0.0f, 0.1f * pass);
+						scene.Local.setPosition((unsigned int)base, position);
+						tree[base]->Position = position;
+						tree[base]->Dirty = true;
+						continue;
+					}
+
+					for (int wheel = 0; wheel < 4; wheel++)
+					{
+						size_t node = base + 1 + wheel * 6;
+						glm::quat rotation = glm::angleAxis(0.2f * pass, right);
+						scene.Local.setRotation((unsigned int)node, rotation);
+						tree[node]->Rotation = rotation;
+						tree[node]->Dirty = true;
+					}
+					if (v % 10 == 0)
+					{
+						glm::quat rotation = glm::angleAxis(0.05f * pass, up);
+						scene.Local.setRotation((unsigned int)(base + turret), rotation);
+						tree[base + turret]->Rotation = rotation;
+						tree[base + turret]->Dirty = true;
+					}
+				}
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for (size_t v = 0; v < vehicleCount; v++)
+					updateTree(tree[v * parts.size()], glm::mat4(1.0f), false);
+				std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+				scene.update();
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+				treeTimes[parked].push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+				flatTimes[parked].push_back(std::chrono::duration<float, std::milli>(end - middle).count());
+				updated[parked] += scene.Updated;
+				for (size_t i = 0; i < scene.size(); i++)
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						glm::vec4 difference = glm::abs(tree[i]->World[c] - scene.World[i][c]);
+						maxError = glm::max(maxError, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < tree.size(); i++)
+			delete tree[i];
+
+		// The trees build their local matrices with glm, the scene graph with the SIMD transform system, so they may round differently.
+		const bool identical = maxError <= 1e-4f;
+		out << "Hierarchy: " << vehicleCount << " vehicles, " << scene.size() << " nodes, " << Passes << " passes, max difference " << maxError << std::endl;
+		const char* names[2] = { "driving", "parked" };
+		for (int parked = 0; parked < 2; parked++)
+		{
+			FrameStatistics treeStats = FrameStatistics::compute(treeTimes[parked]);
+			FrameStatistics flatStats = FrameStatistics::compute(flatTimes[parked]);
+			out << "  " << names[parked] << ", " << updated[parked] / Passes << " world matrices per pass" << std::endl;
+			out << "    pointer tree ms: mean " << treeStats.Mean << ", p50 " << treeStats.P50 << ", max " << treeStats.Max << std::endl;
+			out << "    scene graph  ms: mean " << flatStats.Mean << ", p50 " << flatStats.P50 << ", max " << flatStats.Max
+				<< " (" << treeStats.P50 / flatStats.P50 << "x)" << std::endl;
+		}
+
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::HIERARCHY_RESULTS_DIFFER" << std::endl;
+		return identical;
+	}
+
+	// Build the model matrix of every object with glm::translate and glm::rotate (like the cubes used to), then cull their bounding
+	// spheres, centered on the translation of those matrices.
+	struct JobWorkload
+	{
+		const std::vector<glm::vec3>* Positions;
+		std::vector<glm::mat4> Models;
+		std::vector<unsigned char> Visible;
+		Frustum CameraFrustum;
+
+		void transform(size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), (*Positions)[i]);
+				Models[i] = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+			}
+		}
+
+		void cull(size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				glm::vec3 center(Models[i][3]);
+				bool inside = true;
+				for (int p = 0; p < 6 && inside; p++)
+					inside = glm::dot(glm::vec3(CameraFrustum.Planes[p]), center) + CameraFrustum.Planes[p].w + 0.8660254f >= 0.0f;
+				Visible[i] = inside;
+			}
+		}
+	};
+
+	inline void countJob(void* data)
+	{
+		((std::atomic<long long>*)data)->fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Run the same work with the job system on 1, 2, 4, ... 64 threads: building the matrices and culling (which depends on the
+	// matrices, so it's started after them through a counter), and spawning many tiny jobs to measure the scheduling overhead.
+	// Thread counts beyond the number of cores only show the cost of oversubscription.
+	inline bool jobs(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		const int JobPasses = 10;
+		const int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+		const size_t spawnCount = glm::max(positions.size() / 16, (size_t)1);
+
+		JobWorkload reference;
+		reference.Positions = &positions;
+		reference.Models.resize(positions.size());
+		reference.Visible.resize(positions.size());
+		reference.CameraFrustum = Frustum::fromMatrix(flythroughViewProjections()[0]);
+		reference.transform(0, positions.size());
+		reference.cull(0, positions.size());
+
+		JobWorkload workload = reference;
+		out << "Jobs: " << positions.size() << " objects, " << spawnCount << " spawned jobs, " << JobPasses << " passes, " << cores << " cores" << std::endl;
+
+		bool identical = true;
+		float singleThreaded = 0.0f;
+		for (int threads = 1; threads <= 64; threads *= 2)
+		{
+			JobSystem jobSystem(threads);
+			std::vector<float> graphTimes, spawnTimes;
+			uint64_t stolen = jobSystem.stolen();
+			for (int pass = 0; pass < JobPasses; pass++)
+			{
+				std::fill(workload.Visible.begin(), workload.Visible.end(), 2);
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				JobCounter transformed, culled;
+				auto transform = [&](size_t begin, size_t end) { workload.transform(begin, end); };
+				auto cull = [&](size_t begin, size_t end) { workload.cull(begin, end); };
+				jobSystem.parallelFor(0, positions.size(), 0, transform, transformed);
+				jobSystem.parallelFor(0, positions.size(), 0, cull, culled, &transformed);
+				jobSystem.wait(culled);
+				std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+				std::atomic<long long> count(0);
+				JobCounter spawned;
+				for (size_t i = 0; i < spawnCount; i++)
+					jobSystem.run(&countJob, &count, &spawned);
+				jobSystem.wait(spawned);
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+				graphTimes.push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+				spawnTimes.push_back(std::chrono::duration<float, std::milli>(end - middle).count());
+				identical = identical && workload.Visible == reference.Visible && (size_t)count.load() == spawnCount;
+			}
+
+			FrameStatistics graphStats = FrameStatistics::compute(graphTimes);
+			FrameStatistics spawnStats = FrameStatistics::compute(spawnTimes);
+			if (threads == 1)
+				singleThreaded = graphStats.P50;
+			out << "  " << threads << (threads == 1 ? " thread: " : " threads: ") << "transforms + culling p50 " << graphStats.P50 << " ms ("
+				<< singleThreaded / graphStats.P50 << "x), spawn p50 " << spawnStats.P50 << " ms ("
+				<< spawnStats.P50 * 1000000.0f / spawnCount << " ns per job), " << (jobSystem.stolen() - stolen) / JobPasses << " steals per pass"
+				<< (threads > cores ? " (more threads than cores)" : "") << std::endl;
+		}
+
+		identical = identical && workload.Models == reference.Models;
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::JOBS_RESULTS_DIFFER" << std::endl;
+		return identical;
+	}
+
+	// The transient data of a frame, the way it's usually written: containers created for the frame, filled as the objects come,
+	// and thrown away at its end. The batch table counts the visible objects of every material and mesh combination.
+	template <typename Vector, typename Matrices, typename Batches>
+	inline void buildFrame(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& visible,
+		Vector& drawList, Matrices& models, Batches& batches)
+	{
+		for (size_t i = 0; i < visible.size(); i++)
+		{
+			unsigned int object = visible[i];
+			drawList.push_back(object);
+			models.push_back(glm::translate(glm::mat4(1.0f), positions[object]));
+			batches[(object % 64) * 8 + object % 8]++;
+		}
+	}
+
+	// Build the transient data of a frame for the objects visible from another flythrough frame every pass, once in standard
+	// containers on the heap, and once in frame containers from an arena that's reset every pass. Only the arena's first passes
+	// allocate, until it has grown to the size of a frame.
+	inline bool arena(const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		BoundingSpheres spheres;
+		spheres.reserve(positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			spheres.push_back(positions[i], 0.8660254f);
+
+		std::vector<glm::mat4> viewProjections = flythroughViewProjections();
+		FrustumCuller culler;
+		std::vector<unsigned int> visible;
+
+		// The heap containers of the last pass are thrown away at the start of the next one, so freeing them is timed too.
+		std::vector<unsigned int> heapDrawList;
+		std::vector<glm::mat4> heapModels;
+		std::unordered_map<unsigned int, unsigned int> heapBatches;
+		LinearArena frameArena;
+		std::vector<float> heapTimes, arenaTimes;
+		long long heapAllocations = 0, arenaAllocations = 0, arenaSettledAllocations = 0;
+		bool identical = true;
+		for (int pass = 0; pass < Passes; pass++)
+		{
+			culler.cull(Frustum::fromMatrix(viewProjections[pass]), spheres, visible);
+
+			long long allocations = AllocationCounter::allocations();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			heapDrawList = std::vector<unsigned int>();
+			heapModels = std::vector<glm::mat4>();
+			heapBatches = std::unordered_map<unsigned int, unsigned int>();
+			buildFrame(positions, visible, heapDrawList, heapModels, heapBatches);
+			std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+			heapAllocations += AllocationCounter::allocations() - allocations;
+
+			allocations = AllocationCounter::allocations();
+			std::chrono::steady_clock::time_point arenaStart = std::chrono::steady_clock::now();
+			frameArena.reset();
+			ArenaAllocator<void> allocator(&frameArena);
+			FrameVector<unsigned int> drawList(allocator);
+			FrameVector<glm::mat4> models(allocator);
+			FrameHashMap<unsigned int, unsigned int> batches(0, std::hash<unsigned int>(), std::equal_to<unsigned int>(), allocator);
+			buildFrame(positions, visible, drawList, models, batches);
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			arenaAllocations += AllocationCounter::allocations() - allocations;
+			if (pass >= Passes / 2)
+				arenaSettledAllocations += AllocationCounter::allocations() - allocations;
+
+			heapTimes.push_back(std::chrono::duration<float, std::milli>(middle - start).count());
+			arenaTimes.push_back(std::chrono::duration<float, std::milli>(end - arenaStart).count());
+
+			identical = identical && std::equal(drawList.begin(), drawList.end(), heapDrawList.begin(), heapDrawList.end())
+				&& std::equal(models.begin(), models.end(), heapModels.begin(), heapModels.end()) && batches.size() == heapBatches.size();
+			for (auto batch = heapBatches.begin(); batch != heapBatches.end() && identical; ++batch)
+			{
+				auto found = batches.find(batch->first);
+				identical = found != batches.end() && found->second == batch->second;
+			}
+		}
+
+		FrameStatistics heapStats = FrameStatistics::compute(heapTimes);
+		FrameStatistics arenaStats = FrameStatistics::compute(arenaTimes);
+		out << "Arena: " << positions.size() << " objects, " << Passes << " passes, " << visible.size() << " visible in the last pass" << std::endl;
+		out << "  heap  ms: mean " << heapStats.Mean << ", p50 " << heapStats.P50 << ", max " << heapStats.Max
+			<< ", " << (double)heapAllocations / Passes << " allocations per pass" << std::endl;
+		out << "  arena ms: mean " << arenaStats.Mean << ", p50 " << arenaStats.P50 << ", max " << arenaStats.Max
+			<< " (" << heapStats.P50 / arenaStats.P50 << "x), " << (double)arenaAllocations / Passes << " allocations per pass, "
+			<< arenaSettledAllocations << " in the last " << Passes - Passes / 2 << " passes (arena " << frameArena.capacity() / 1024 << " KB)" << std::endl;
+
+		if (!identical)
+			std::cout << "ERROR::MICROBENCHMARK::ARENA_RESULTS_DIFFER" << std::endl;
+		return identical;
+	}
+
+	// Run a microbenchmark by name. Returns false if its optimized implementation gave a different result than the reference.
+	inline bool run(const std::string& name, const std::vector<glm::vec3>& positions, std::ostream& out)
+	{
+		if (name == "sort")
+			return sort(positions, out);
+		if (name == "transforms")
+			return transforms(positions, out);
+		if (name == "hierarchy")
+			return hierarchy(positions, out);
+		if (name == "jobs")
+			return jobs(positions, out);
+		if (name == "arena")
+			return arena(positions, out);
+		return culling(positions, out);
+	}
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GpuProfiler.h"
+#include "RenderState.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+#include "StreamBuffer.h"
+
+#include <cctype>
+#include <cstdio>
+#include <vector>
+
+// Draws the profiler's timings on top of the frame: a line per scope with its average CPU and GPU time and a bar for each.
+// Text is drawn with a tiny built-in 5x7 pixel font, so the overlay doesn't need any font files. The glyphs are packed into
+// a single-channel texture once, and every frame the overlay's quads are streamed to the GPU through a StreamBuffer.
+class ProfilerOverlay
+{
+public:
+	// Size of a screen pixel of the font, in framebuffer pixels.
+	static const int Scale = 2;
+
+	ProfilerOverlay() : shader(NULL), fontTexture(0), vao(0)
+	{
+	}
+
+	// Build the font texture, shader and vertex array. Must be called with the context current.
+	void create(ShaderCache* cache)
+	{
+		shader = new Shader("overlay.vs", "overlay.fs", cache);
+		screenSizeUniform = shader->getUniform<glm::vec4>("screenSize");
+		shader->use();
+		shader->setInt("font", 0);
+
+		createFontTexture();
+
+		// Every character is a quad of 2 triangles, the overlay can draw up to 4096 of them (including the bars) per frame.
+		glGenVertexArrays(1, &vao);
+		renderState().bindVertexArray(vao);
+		vertices.create(GL_ARRAY_BUFFER, 4096 * 6 * sizeof(Vertex));
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		renderState().bindVertexArray(0);
+	}
+
+	// Draw the overlay in the top left corner of a framebuffer of the given size.
+	void draw(const GpuProfiler& profiler, int width, int height)
+	{
+		quads.clear();
+
+		char line[128];
+		float x = 8.0f, y = 8.0f;
+		const float lineHeight = (float)(CellHeight + 2) * Scale;
+		const float textWidth = 38.0f * CellWidth * Scale;
+		const float barScale = 40.0f * Scale;	// pixels per millisecond
+		const float barWidth = 100.0f * Scale;
+
+		// Dark background behind the text, so it's readable on top of anything.
+		int lines = (int)profiler.Averages.size() + 1;
+		addRectangle(x - 4.0f, y - 4.0f, textWidth + barWidth + 8.0f, lines * lineHeight + 6.0f, 0, 0, 0, 160);
+
+		snprintf(line, sizeof(line), "%-16s %7s %7s", "SCOPE", "CPU MS", "GPU MS");
+		addText(x, y, line, 255, 255, 160);
+		y += lineHeight;
+
+		for (size_t i = 0; i < profiler.Averages.size(); i++)
+		{
+			const GpuProfiler::Average& average = profiler.Averages[i];
+			char name[32];
+			snprintf(name, sizeof(name), "%*s%s", 2 * average.Depth, "", average.Name);
+			snprintf(line, sizeof(line), "%-16.16s %7.3f %7.3f", name, average.Cpu, average.Gpu);
+			addText(x, y, line, 255, 255, 255);
+
+			// CPU time on the upper half of the line, GPU time on the lower half.
+			float barHeight = (float)CellHeight * Scale / 2.0f;
+			addRectangle(x + textWidth, y, glm::min((float)average.Cpu * barScale, barWidth), barHeight - 1.0f, 255, 160, 64, 255);
+			addRectangle(x + textWidth, y + barHeight, glm::min((float)average.Gpu * barScale, barWidth), barHeight - 1.0f, 96, 224, 96, 255);
+			y += lineHeight;
+		}
+
+		GLintptr offset = 0;
+		GLsizeiptr size = (GLsizeiptr)(quads.size() * sizeof(Vertex));
+		void* destination = vertices.map(size, sizeof(Vertex), offset);
+		if (!destination)
+			return;
+		memcpy(destination, quads.data(), size);
+		vertices.unmap();
+
+		renderState().bindVertexArray(vao);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offset);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + 2 * sizeof(float)));
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offset + 4 * sizeof(float)));
+
+		// The overlay is blended on top of everything, regardless of depth.
+		shader->use();
+		shader->set(screenSizeUniform, glm::vec4((float)width, (float)height, 0.0f, 0.0f));
+		renderState().bindTexture(0, fontTexture);
+		renderState().setDepthTest(false);
+		renderState().setBlend(true);
+		renderState().setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)quads.size());
+		renderState().setBlend(false);
+		renderState().setDepthTest(true);
+	}
+
+	// Call once the frame's draws are issued, so the vertex buffer knows when the GPU is done with this frame's quads.
+	void endFrame()
+	{
+		vertices.endFrame();
+	}
+
+	// Release the shader, vertex buffer, vertex array and font texture. Must be called while the context is still current.
+	void destroy()
+	{
+		// Unbind the vertex array and the font texture (only ever bound to unit 0) through the state cache before deleting them,
+		// as OpenGL may hand out their names again.
+		renderState().bindVertexArray(0);
+		renderState().bindTexture(0, 0);
+		vertices.destroy();
+		glDeleteVertexArrays(1, &vao);
+		glDeleteTextures(1, &fontTexture);
+		vao = 0;
+		fontTexture = 0;
+		delete shader;
+		shader = NULL;
+	}
+
+private:
+	// Every glyph is 5x7 pixels, in a cell of 6x8 so there's a pixel of space between characters and lines.
+	static const int CellWidth = 6;
+	static const int CellHeight = 8;
+
+	// The font texture holds the characters 32 (space) to 127 in 16 columns and 6 rows. Character 127 is a solid block,
+	// which the rectangles sample.
+	static const int AtlasColumns = 16;
+	static const int AtlasRows = 6;
+
+	struct Vertex
+	{
+		float X, Y;
+		float U, V;
+		unsigned char Color[4];
+	};
+
+	Shader* shader;
+	Uniform<glm::vec4> screenSizeUniform;
+	unsigned int fontTexture;
+	unsigned int vao;
+	StreamBuffer vertices;
+	std::vector<Vertex> quads;
+
+	struct Glyph
+	{
+		char Character;
+		const char* Rows[7];
+	};
+
+	// The font only has upper case letters, lower case text is drawn in upper case.
+	static const Glyph* glyphs(int& count)
+	{
+		static const Glyph font[] = {
+			{ 'A', { " ### ", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+			{ 'B', { "#### ", "#   #", "#   #", "#### ", "#   #", "#   #", "#### " } },
+			{ 'C', { " ### ", "#   #", "#    ", "#    ", "#    ", "#   #", " ### " } },
+			{ 'D', { "#### ", "#   #", "#   #", "#   #", "#   #", "#   #", "#### " } },
+			{ 'E', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#####" } },
+			{ 'F', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#    " } },
+			{ 'G', { " ### ", "#   #", "#    ", "# ###", "#   #", "#   #", " ####" } },
+			{ 'H', { "#   #", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+			{ 'I', { " ### ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+			{ 'J', { "  ###", "   # ", "   # ", "   # ", "   # ", "#  # ", " ##  " } },
+			{ 'K', { "#   #", "#  # ", "# #  ", "##   ", "# #  ", "#  # ", "#   #" } },
+			{ 'L', { "#    ", "#    ", "#    ", "#    ", "#    ", "#    ", "#####" } },
+			{ 'M', { "#   #", "## ##", "# # #", "# # #", "#   #", "#   #", "#   #" } },
+			{ 'N', { "#   #", "#   #", "##  #", "# # #", "#  ##", "#   #", "#   #" } },
+			{ 'O', { " ### ", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+			{ 'P', { "#### ", "#   #", "#   #", "#### ", "#    ", "#    ", "#    " } },
+			{ 'Q', { " ### ", "#   #", "#   #", "#   #", "# # #", "#  # ", " ## #" } },
+			{ 'R', { "#### ", "#   #", "#   #", "#### ", "# #  ", "#  # ", "#   #" } },
+			{ 'S', { " ####", "#    ", "#    ", " ### ", "    #", "    #", "#### " } },
+			{ 'T', { "#####", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  " } },
+			{ 'U', { "#   #", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+			{ 'V', { "#   #", "#   #", "#   #", "#   #", "#   #", " # # ", "  #  " } },
+			{ 'W', { "#   #", "#   #", "#   #", "# # #", "# # #", "# # #", " # # " } },
+			{ 'X', { "#   #", "#   #", " # # ", "  #  ", " # # ", "#   #", "#   #" } },
+			{ 'Y', { "#   #", "#   #", " # # ", "  #  ", "  #  ", "  #  ", "  #  " } },
+			{ 'Z', { "#####", "    #", "   # ", "  #  ", " #   ", "#    ", "#####" } },
+			{ '0', { " ### ", "#   #", "#  ##", "# # #", "##  #", "#   #", " ### " } },
+			{ '1', { "  #  ", " ##  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+			{ '2', { " ### ", "#   #", "    #", "   # ", "  #  ", " #   ", "#####" } },
+			{ '3', { "#####", "   # ", "  #  ", "   # ", "    #", "#   #", " ### " } },
+			{ '4', { "   # ", "  ## ", " # # ", "#  # ", "#####", "   # ", "   # " } },
+			{ '5', { "#####", "#    ", "#### ", "    #", "    #", "#   #", " ### " } },
+			{ '6', { "  ## ", " #   ", "#    ", "#### ", "#   #", "#   #", " ### " } },
+			{ '7', { "#####", "    #", "   # ", "  #  ", " #   ", " #   ", " #   " } },
+			{ '8', { " ### ", "#   #", "#   #", " ### ", "#   #", "#   #", " ### " } },
+			{ '9', { " ### ", "#   #", "#   #", " ####", "    #", "   # ", " ##  " } },
+			{ '.', { "     ", "     ", "     ", "     ", "     ", " ##  ", " ##  " } },
+			{ ',', { "     ", "     ", "     ", "     ", " ##  ", "  #  ", " #   " } },
+			{ ':', { "     ", " ##  ", " ##  ", "     ", " ##  ", " ##  ", "     " } },
+			{ '-', { "     ", "     ", "     ", "#####", "     ", "     ", "     " } },
+			{ '+', { "     ", "  #  ", "  #  ", "#####", "  #  ", "  #  ", "     " } },
+			{ '=', { "     ", "     ", "#####", "     ", "#####", "     ", "     " } },
+			{ '_', { "     ", "     ", "     ", "     ", "     ", "     ", "#####" } },
+			{ '/', { "     ", "    #", "   # ", "  #  ", " #   ", "#    ", "     " } },
+			{ '%', { "##   ", "##  #", "   # ", "  #  ", " #   ", "#  ##", "   ##" } },
+			{ '(', { "   # ", "  #  ", " #   ", " #   ", " #   ", "  #  ", "   # " } },
+			{ ')', { " #   ", "  #  ", "   # ", "   # ", "   # ", "  #  ", " #   " } },
+			{ '?', { " ### ", "#   #", "    #", "   # ", "  #  ", "     ", "  #  " } }
+		};
+		count = sizeof(font) / sizeof(font[0]);
+		return font;
+	}
+
+	void createFontTexture()
+	{
+		const int width = AtlasColumns * CellWidth;
+		const int height = AtlasRows * CellHeight;
+		std::vector<unsigned char> pixels(width * height, 0);
+
+		int count = 0;
+		const Glyph* font = glyphs(count);
+		for (int i = 0; i < count; i++)
+		{
+			int cell = font[i].Character - 32;
+			int cellX = (cell % AtlasColumns) * CellWidth;
+			int cellY = (cell / AtlasColumns) * CellHeight;
+			for (int row = 0; row < 7; row++)
+			{
+				for (int column = 0; column < 5; column++)
+				{
+					if (font[i].Rows[row][column] == '#')
+						pixels[(cellY + row) * width + cellX + column] = 255;
+				}
+			}
+		}
+
+		// Character 127: a solid cell.
+		int solidX = (95 % AtlasColumns) * CellWidth, solidY = (95 / AtlasColumns) * CellHeight;
+		for (int row = 0; row < CellHeight; row++)
+		{
+			for (int column = 0; column < CellWidth; column++)
+				pixels[(solidY + row) * width + solidX + column] = 255;
+		}
+
+		glGenTextures(1, &fontTexture);
+		renderState().bindTexture(0, fontTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// Magnified without filtering, so the pixels of the font stay sharp.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	// Add a quad in pixels (origin in the top left corner) showing a rectangle of the font texture, in texels.
+	void addQuad(float x, float y, float width, float height, float u, float v, float textureWidth, float textureHeight,
+		unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+	{
+		const float atlasWidth = (float)(AtlasColumns * CellWidth), atlasHeight = (float)(AtlasRows * CellHeight);
+		Vertex corners[4];
+		for (int i = 0; i < 4; i++)
+		{
+			float right = (i == 1 || i == 2) ? 1.0f : 0.0f;
+			float bottom = (i >= 2) ? 1.0f : 0.0f;
+			corners[i].X = x + right * width;
+			corners[i].Y = y + bottom * height;
+			corners[i].U = (u + right * textureWidth) / atlasWidth;
+			corners[i].V = (v + bottom * textureHeight) / atlasHeight;
+			corners[i].Color[0] = r;
+			corners[i].Color[1] = g;
+			corners[i].Color[2] = b;
+			corners[i].Color[3] = a;
+		}
+
+		quads.push_back(corners[0]);
+		quads.push_back(corners[1]);
+		quads.push_back(corners[2]);
+		quads.push_back(corners[0]);
+		quads.push_back(corners[2]);
+		quads.push_back(corners[3]);
+	}
+
+	void addRectangle(float x, float y, float width, float height, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+	{
+		if (width <= 0.0f || height <= 0.0f)
+			return;
+
+		// Sample the middle of the solid cell, so the texture is fully covered anywhere in the rectangle.
+		float solidU = (95 % AtlasColumns) * CellWidth + CellWidth / 2.0f;
+		float solidV = (95 / AtlasColumns) * CellHeight + CellHeight / 2.0f;
+		addQuad(x, y, width, height, solidU, solidV, 0.0f, 0.0f, r, g, b, a);
+	}
+
+	void addText(float x, float y, const char* text, unsigned char r, unsigned char g, unsigned char b)
+	{
+		for (const char* c = text; *c; c++, x += CellWidth * Scale)
+		{
+			int character = toupper((unsigned char)*c);
+			if (character == ' ')
+				continue;
+			if (character < 32 || character > 126)
+				character = '?';
+
+			int cell = character - 32;
+			float u = (float)((cell % AtlasColumns) * CellWidth);
+			float v = (float)((cell / AtlasColumns) * CellHeight);
+			addQuad(x, y, (float)CellWidth * Scale, (float)CellHeight * Scale, u, v, (float)CellWidth, (float)CellHeight, r, g, b, 255);
+		}
+	}
+};
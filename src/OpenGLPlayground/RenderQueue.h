@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Passes of a frame, in the order they're drawn. The pass is stored in the top bits of every sort key, so sorting
+// the queue also puts the passes in order.
+enum RenderPass
+{
+	OpaquePass = 0,
+	TransparentPass = 1,
+	OverlayPass = 2
+};
+
+// A draw the render loop wants to make: the sort key deciding its place in the frame, and the object to draw.
+struct DrawPacket
+{
+	uint64_t Key;
+	unsigned int Object;
+};
+
+// Collects the draws of a frame and sorts them into the order they should be submitted in.
+// Drawing objects in the order they happen to be stored in switches shaders, textures and vertex arrays back and forth, and draws
+// far away objects before the ones covering them. Instead, every draw gets a 64-bit sort key packing the state it needs,
+// most expensive state change first, and the packets are sorted by key:
+//
+//	opaque:			| pass (2) | program (10) | material (12) | vertex array (10) | depth (30) |
+//	transparent:	| pass (2) | inverted depth (30) | program (10) | material (12) | vertex array (10) |
+//
+// Opaque draws sharing the same state end up next to each other, so each state is set once, and within the same state they're
+// drawn front to back, so the depth test rejects hidden fragments before they're shaded (early-Z). Transparent draws have to be
+// blended back to front, so depth comes first for them. Program, material and vertex array are small indices the caller
+// assigns (not OpenGL names), and depth is the distance along the view direction quantized by depthBits().
+//
+// The keys are sorted with an LSD radix sort: one pass per byte of the key, each a linear counting pass, rather than the
+// O(n log n) comparisons of std::sort. Bytes every key has in common (e.g. the pass, or the program in a scene with a single shader)
+// are skipped.
+class RenderQueue
+{
+public:
+	static const int DepthBits = 30;
+	static const int VertexArrayBits = 10;
+	static const int MaterialBits = 12;
+	static const int ProgramBits = 10;
+
+	std::vector<DrawPacket> Packets;
+
+	void clear()
+	{
+		Packets.clear();
+	}
+
+	void reserve(size_t count)
+	{
+		Packets.reserve(count);
+		scratch.reserve(count);
+	}
+
+	void push(uint64_t key, unsigned int object)
+	{
+		DrawPacket packet;
+		packet.Key = key;
+		packet.Object = object;
+		Packets.push_back(packet);
+	}
+
+	size_t size() const
+	{
+		return Packets.size();
+	}
+
+	// Sort key of an opaque draw.
+	static uint64_t opaqueKey(RenderPass pass, unsigned int program, unsigned int material, unsigned int vertexArray, unsigned int depth)
+	{
+		return (uint64_t)pass << 62
+			| (uint64_t)(program & mask(ProgramBits)) << 52
+			| (uint64_t)(material & mask(MaterialBits)) << 40
+			| (uint64_t)(vertexArray & mask(VertexArrayBits)) << 30
+			| (depth & mask(DepthBits));
+	}
+
+	// Sort key of a blended draw, ordered back to front.
+	static uint64_t transparentKey(RenderPass pass, unsigned int depth, unsigned int program, unsigned int material, unsigned int vertexArray)
+	{
+		return (uint64_t)pass << 62
+			| (uint64_t)(mask(DepthBits) - (depth & mask(DepthBits))) << 32
+			| (uint64_t)(program & mask(ProgramBits)) << 22
+			| (uint64_t)(material & mask(MaterialBits)) << 10
+			| (vertexArray & mask(VertexArrayBits));
+	}
+
+	// Quantize the distance along the view direction to the depth bits of a key. Distances outside [near, far] are clamped.
+	// The scaling is done in double: as a float, the largest depth (2^30 - 1) rounds up to 2^30, which doesn't fit the depth bits
+	// and would wrap the farthest objects around to the front.
+	static unsigned int depthBits(float distance, float nearPlane, float farPlane)
+	{
+		double normalized = ((double)distance - nearPlane) / ((double)farPlane - nearPlane);
+		normalized = std::min(std::max(normalized, 0.0), 1.0);
+		return std::min((unsigned int)(normalized * mask(DepthBits)), mask(DepthBits));
+	}
+
+	// Sort the packets by key. The sort is stable: packets with the same key stay in the order they were pushed.
+	void sort()
+	{
+		const size_t count = Packets.size();
+		if (count < 2)
+			return;
+		scratch.resize(count);
+
+		// Count the values of all 8 bytes of the keys in a single pass.
+		memset(histograms, 0, sizeof(histograms));
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t key = Packets[i].Key;
+			for (int digit = 0; digit < 8; digit++)
+				histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+		}
+
+		DrawPacket* source = Packets.data();
+		DrawPacket* destination = scratch.data();
+		for (int digit = 0; digit < 8; digit++)
+		{
+			const int shift = digit * 8;
+			unsigned int* histogram = histograms[digit];
+
+			// When every key has the same byte here, this pass wouldn't move anything.
+			if (histogram[(source[0].Key >> shift) & 0xFF] == count)
+				continue;
+
+			// Turn the counts into the position the first packet with each byte value goes to.
+			unsigned int offset = 0;
+			for (int value = 0; value < 256; value++)
+			{
+				unsigned int valueCount = histogram[value];
+				histogram[value] = offset;
+				offset += valueCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				destination[histogram[(source[i].Key >> shift) & 0xFF]++] = source[i];
+
+			std::swap(source, destination);
+		}
+
+		// After an odd number of passes the sorted packets are in the scratch buffer.
+		if (source != Packets.data())
+			Packets.swap(scratch);
+	}
+
+	// Sort with std::stable_sort instead, the reference the radix sort is checked and benchmarked against.
+	void sortReference()
+	{
+		std::stable_sort(Packets.begin(), Packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.Key < b.Key; });
+	}
+
+private:
+	std::vector<DrawPacket> scratch;
+	unsigned int histograms[8][256];
+
+	static unsigned int mask(int bits)
+	{
+		return (1u << bits) - 1u;
+	}
+};
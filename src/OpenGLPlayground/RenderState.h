@@ -0,0 +1,224 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Shadow copy of the OpenGL state the playground changes, sitting in front of the GL calls.
+// OpenGL doesn't skip a call that sets state to the value it already has: every glBindTexture or glUseProgram goes through
+// the driver's validation, even when nothing changes. Remembering what's bound lets us drop those redundant calls on the CPU side.
+// This only works when all code changes this state through the cache, so the GL calls below must not be made directly anywhere else
+// (or invalidate() has to be called afterwards). Objects should be unbound through the cache before they're deleted,
+// as OpenGL may hand out the same name again for a new object.
+class RenderState
+{
+public:
+	// Number of texture units tracked, the minimum OpenGL 3.3 guarantees for the fragment shader.
+	static const unsigned int MaxTextureUnits = 16;
+
+	// Calls passed on to OpenGL, and calls skipped because the state was already set, since the last resetCounters().
+	int Issued;
+	int Skipped;
+
+	RenderState() : Issued(0), Skipped(0)
+	{
+		invalidate();
+	}
+
+	// Forget all cached state, so the next call of every kind is passed on to OpenGL.
+	// Needed when the state is changed behind the cache's back, e.g. by creating a new context.
+	void invalidate()
+	{
+		program = Unknown;
+		vertexArray = Unknown;
+		activeTexture = Unknown;
+		for (unsigned int i = 0; i < MaxTextureUnits; i++)
+			textures[i] = Unknown;
+		for (int i = 0; i < BufferTargetCount; i++)
+			buffers[i] = Unknown;
+		depthTest = Unknown;
+		blend = Unknown;
+		blendSource = blendDestination = Unknown;
+		viewportX = viewportY = viewportWidth = viewportHeight = -1;
+	}
+
+	void resetCounters()
+	{
+		Issued = 0;
+		Skipped = 0;
+	}
+
+	void useProgram(unsigned int id)
+	{
+		if (changed(program, id))
+			glUseProgram(id);
+	}
+
+	void bindVertexArray(unsigned int id)
+	{
+		if (changed(vertexArray, id))
+			glBindVertexArray(id);
+	}
+
+	// Bind a 2D texture to a texture unit, only switching the active texture unit when the binding actually changes.
+	void bindTexture(unsigned int unit, unsigned int texture)
+	{
+		if (unit >= MaxTextureUnits)
+		{
+			setActiveTexture(unit);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			Issued++;
+			return;
+		}
+
+		if (textures[unit] == texture)
+		{
+			Skipped++;
+			return;
+		}
+
+		setActiveTexture(unit);
+		textures[unit] = texture;
+		glBindTexture(GL_TEXTURE_2D, texture);
+		Issued++;
+	}
+
+	// Bind a buffer to a target.
+	// The GL_ELEMENT_ARRAY_BUFFER binding is part of the bound vertex array object rather than global state, so it's always passed on.
+	void bindBuffer(GLenum target, unsigned int buffer)
+	{
+		int index = bufferTargetIndex(target);
+		if (index == -1)
+		{
+			glBindBuffer(target, buffer);
+			Issued++;
+			return;
+		}
+
+		if (changed(buffers[index], buffer))
+			glBindBuffer(target, buffer);
+	}
+
+	// Bind a buffer to an indexed binding point (e.g. of a uniform block). Like OpenGL, this also binds it to the generic target.
+	void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+	{
+		glBindBufferBase(target, index, buffer);
+		Issued++;
+
+		int targetIndex = bufferTargetIndex(target);
+		if (targetIndex != -1)
+			buffers[targetIndex] = buffer;
+	}
+
+	void setDepthTest(bool enabled)
+	{
+		if (!changed(depthTest, enabled ? 1u : 0u))
+			return;
+
+		if (enabled)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+	}
+
+	void setBlend(bool enabled)
+	{
+		if (!changed(blend, enabled ? 1u : 0u))
+			return;
+
+		if (enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+	}
+
+	void setBlendFunc(GLenum source, GLenum destination)
+	{
+		if (blendSource == source && blendDestination == destination)
+		{
+			Skipped++;
+			return;
+		}
+
+		blendSource = source;
+		blendDestination = destination;
+		glBlendFunc(source, destination);
+		Issued++;
+	}
+
+	void setViewport(int x, int y, int width, int height)
+	{
+		if (viewportX == x && viewportY == y && viewportWidth == width && viewportHeight == height)
+		{
+			Skipped++;
+			return;
+		}
+
+		viewportX = x;
+		viewportY = y;
+		viewportWidth = width;
+		viewportHeight = height;
+		glViewport(x, y, width, height);
+		Issued++;
+	}
+
+private:
+	// Marks state that hasn't been set through the cache yet, no real object name or value equals it.
+	static const unsigned int Unknown = 0xFFFFFFFFu;
+
+	// Buffer targets with a global binding.
+	static const int BufferTargetCount = 5;
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeTexture;
+	unsigned int textures[MaxTextureUnits];
+	unsigned int buffers[BufferTargetCount];
+	unsigned int depthTest;
+	unsigned int blend;
+	unsigned int blendSource, blendDestination;
+	int viewportX, viewportY, viewportWidth, viewportHeight;
+
+	// Update a cached value. Returns true (and counts the call as issued) if the value changed and the GL call has to be made.
+	bool changed(unsigned int& cached, unsigned int value)
+	{
+		if (cached == value)
+		{
+			Skipped++;
+			return false;
+		}
+
+		cached = value;
+		Issued++;
+		return true;
+	}
+
+	// Select the texture unit subsequent glBindTexture calls apply to. Only called when a texture is actually bound.
+	void setActiveTexture(unsigned int unit)
+	{
+		if (activeTexture == unit)
+			return;
+
+		activeTexture = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		Issued++;
+	}
+
+	static int bufferTargetIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_UNIFORM_BUFFER: return 1;
+		case GL_PIXEL_UNPACK_BUFFER: return 2;
+		case GL_PIXEL_PACK_BUFFER: return 3;
+		case GL_COPY_WRITE_BUFFER: return 4;
+		default: return -1;
+		}
+	}
+};
+
+// The render state of the current context.
+inline RenderState& renderState()
+{
+	static RenderState state;
+	return state;
+}
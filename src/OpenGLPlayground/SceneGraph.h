@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TransformSystem.h"
+
+#include <iostream>
+#include <vector>
+
+// A hierarchy of objects (e.g. the wheels, turret and barrel of a vehicle), stored as flat arrays instead of a tree of pointers.
+// Nodes are kept in depth-first order: every node comes after its parent, and a node's whole subtree is the range of nodes right
+// after it, [node, SubtreeEnd[node]). That's what makes the update a single linear pass over the arrays:
+//	- a node's parent has always been updated before the node itself, so World[Parent[i]] is up to date when node i needs it;
+//	- when a node moves, everything that has to follow it is one contiguous range, so there's no need to walk any children lists.
+// The local transforms live in a TransformSystem, which builds the local matrices of the moved nodes with SIMD and marks them dirty.
+class SceneGraph
+{
+public:
+	static const int NoParent = -1;
+
+	// Transforms relative to the parent node (or the world, for root nodes). Move nodes through Local.setPosition() etc.
+	TransformSystem Local;
+
+	// Index of every node's parent, always smaller than the node's own index, or NoParent.
+	std::vector<int> Parent;
+
+	// One past the last node of every node's subtree.
+	std::vector<unsigned int> SubtreeEnd;
+
+	// Transforms from every node to the world, as of the last update().
+	std::vector<glm::mat4> World;
+
+	// Number of world matrices recomputed by the last update() call.
+	size_t Updated;
+
+	SceneGraph() : Updated(0)
+	{
+	}
+
+	size_t size() const
+	{
+		return Parent.size();
+	}
+
+	void reserve(size_t count)
+	{
+		Local.reserve(count);
+		Parent.reserve(count);
+		SubtreeEnd.reserve(count);
+		World.reserve(count);
+	}
+
+	// Add a node below parent (or a new root, with NoParent), returning its index.
+	// To keep the nodes in depth-first order, the parent has to be the last node added, or one of its ancestors: build a hierarchy
+	// the way you would walk it, adding each node's children (and their children) before the node's next sibling. Returns -1 otherwise.
+	int add(int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		if (parent != NoParent && (parent < 0 || (size_t)parent >= size() || SubtreeEnd[parent] != size()))
+		{
+			std::cout << "ERROR::SCENE_GRAPH::NOT_DEPTH_FIRST node added below " << parent << std::endl;
+			return -1;
+		}
+
+		int index = (int)Local.add(position, rotation, scale);
+		Parent.push_back(parent);
+		SubtreeEnd.push_back((unsigned int)index + 1);
+		World.push_back(glm::mat4(1.0f));
+
+		// The new node ends the subtree of each of its ancestors.
+		for (int ancestor = parent; ancestor != NoParent; ancestor = Parent[ancestor])
+			SubtreeEnd[ancestor] = (unsigned int)index + 1;
+		return index;
+	}
+
+	// Rebuild the local matrices of the nodes that moved, then the world matrices of those nodes and everything below them.
+	void update()
+	{
+		Local.compose();
+
+		// Past the end of the last subtree that moved, a node only has to be recomputed if it moved itself.
+		Updated = 0;
+		size_t movedEnd = 0;
+		for (size_t i = 0; i < size(); i++)
+		{
+			if (i >= movedEnd)
+			{
+				if (!Local.isDirty((unsigned int)i))
+					continue;
+				movedEnd = SubtreeEnd[i];
+			}
+
+			World[i] = Parent[i] == NoParent ? Local.Matrices[i] : World[Parent[i]] * Local.Matrices[i];
+			Updated++;
+		}
+
+		Local.clearDirty();
+	}
+};
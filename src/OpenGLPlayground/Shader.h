@@ -1,24 +1,87 @@
 #pragma once
 
-#include <glad\glad.h>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include "GLExtensions.h"
+#include "ShaderCache.h"
+#include "RenderState.h"
+#include "UniformBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+// Handle to a uniform of type T, holding its precomputed location.
+// Obtain one once through Shader::getUniform, and set the value every frame through Shader::set without any string lookups or allocations.
+template <typename T>
+struct Uniform
+{
+	int Location;
+
+	Uniform() : Location(-1)
+	{
+	}
+
+	explicit Uniform(int location) : Location(location)
+	{
+	}
+
+	// A uniform that doesn't exist (or was optimized away by the GLSL compiler) has location -1, setting it is silently ignored by OpenGL.
+	bool isValid() const
+	{
+		return Location != -1;
+	}
+};
+
+// Maps the C++ type of a uniform handle to the GLSL types it may be used for.
+template <typename T> struct UniformType;
+template <> struct UniformType<bool> { static bool matches(GLenum type) { return type == GL_BOOL || type == GL_INT; } };
+template <> struct UniformType<int> { static bool matches(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_3D || type == GL_SAMPLER_CUBE; } };
+template <> struct UniformType<float> { static bool matches(GLenum type) { return type == GL_FLOAT; } };
+template <> struct UniformType<glm::vec3> { static bool matches(GLenum type) { return type == GL_FLOAT_VEC3; } };
+template <> struct UniformType<glm::vec4> { static bool matches(GLenum type) { return type == GL_FLOAT_VEC4; } };
+template <> struct UniformType<glm::mat4> { static bool matches(GLenum type) { return type == GL_FLOAT_MAT4; } };
 
 class Shader
 {
 public:
-	// Shader program identifier.
+	// Shader program identifier. Replaced by a new program when the shader is reloaded.
 	unsigned int Id;
 
-	// Read and build the shader.
-	Shader(const char* vertexPath, const char* fragmentPath)
+	// Where the shader was loaded from, and the sources of the current program.
+	std::string VertexPath;
+	std::string FragmentPath;
+	std::string VertexCode;
+	std::string FragmentCode;
+
+	// An active uniform of the linked program, as reported by OpenGL.
+	struct UniformInfo
+	{
+		std::string Name;
+		int Location;
+		GLenum Type;
+		int Size;
+	};
+
+	// All active uniforms of the program, sorted by name.
+	// Reflected once after linking, so looking up a location never has to ask the driver (glGetUniformLocation) again.
+	std::vector<UniformInfo> Uniforms;
+
+	// Read the shader and start building it.
+	// When a shader cache is given, the linked program is loaded from (or stored in) the cache instead of always compiling it.
+	// Compiling and linking aren't waited for here: checking whether they succeeded would block until the driver is done, and keep it
+	// from working on several programs at once. The program is finished (checked, and its uniforms reflected) when it's first used,
+	// or by an explicit finish(), see ShaderLibrary.h.
+	Shader(const char* vertexPath, const char* fragmentPath, ShaderCache* cache = NULL) : VertexPath(vertexPath), FragmentPath(fragmentPath), cache(cache), pending(false), loadedFromCache(false), vertex(0), fragment(0), buildSeconds(0.0)
 	{
 		// Load shader source code.
-		std::string vertexCode;
-		std::string fragmentCode;
 		std::ifstream vShaderFile;
 		std::ifstream fShaderFile;
 
@@ -37,86 +100,333 @@ public:
 			vShaderFile.close();
 			fShaderFile.close();
 
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+			VertexCode = vShaderStream.str();
+			FragmentCode = fShaderStream.str();
 		}
 		catch (std::ifstream::failure e)
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 		}
 
+		submit(VertexCode, FragmentCode, Id);
+		pending = true;
+	}
+
+	// Whether finish() would return right away. Without GL_KHR_parallel_shader_compile there's no way to tell, so it's assumed done.
+	bool isReady() const
+	{
+		if (!pending || !glExtensions().ParallelShaderCompile)
+			return true;
+
+		int completed = GL_FALSE;
+		glGetProgramiv(Id, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
+
+	bool isPending() const
+	{
+		return pending;
+	}
+
+	// Wait for the program to be compiled and linked, report errors, and reflect its uniforms.
+	void finish()
+	{
+		if (!pending)
+			return;
+
+		pending = false;
+		complete(Id);
+		reflectUniforms();
+		bindUniformBlocks();
+	}
+
+	// Rebuild the program from new sources, e.g. after the shader files were edited.
+	// The new program only replaces the current one if it compiled and linked, otherwise the current program stays in use.
+	// Uniform locations and values (e.g. sampler units) may change, so uniform handles have to be looked up and set again afterwards.
+	bool reload(const std::string& vertexCode, const std::string& fragmentCode)
+	{
+		finish();
+
+		unsigned int program = 0;
+		submit(vertexCode, fragmentCode, program);
+		if (!complete(program))
+		{
+			glDeleteProgram(program);
+			std::cout << "ERROR::SHADER::RELOAD_FAILED " << VertexPath << " + " << FragmentPath << ", keeping the previous program" << std::endl;
+			return false;
+		}
+
+		// Unbind the old program through the state cache before deleting it, as OpenGL may hand out its name again.
+		renderState().useProgram(0);
+		glDeleteProgram(Id);
+		Id = program;
+		VertexCode = vertexCode;
+		FragmentCode = fragmentCode;
+
+		Uniforms.clear();
+		reflectUniforms();
+		bindUniformBlocks();
+		return true;
+	}
+
+	// Use/activate the shader.
+	void use()
+	{
+		finish();
+		renderState().useProgram(Id);
+	}
+
+	// Find an active uniform in the reflected uniform table (a binary search, no driver calls). Returns NULL if the program has no such uniform.
+	const UniformInfo* findUniform(const char* name) const
+	{
+		ensureFinished();
+		std::vector<UniformInfo>::const_iterator it = std::lower_bound(Uniforms.begin(), Uniforms.end(), name,
+			[](const UniformInfo& info, const char* key) { return strcmp(info.Name.c_str(), key) < 0; });
+		if (it == Uniforms.end() || strcmp(it->Name.c_str(), name) != 0)
+			return NULL;
+		return &*it;
+	}
+
+	// Location of a uniform, or -1 if the program has no such active uniform.
+	int getUniformLocation(const char* name) const
+	{
+		const UniformInfo* info = findUniform(name);
+		return info ? info->Location : -1;
+	}
+
+	// Get a typed handle to a uniform. Warns when the uniform doesn't exist, or when its GLSL type doesn't match T.
+	template <typename T>
+	Uniform<T> getUniform(const char* name) const
+	{
+		const UniformInfo* info = findUniform(name);
+		if (!info)
+		{
+			std::cout << "WARNING::SHADER::UNIFORM_NOT_FOUND " << name << std::endl;
+			return Uniform<T>();
+		}
+
+		if (!UniformType<T>::matches(info->Type))
+			std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+
+		return Uniform<T>(info->Location);
+	}
+
+	// Set uniform values through typed handles. These are the ones to use in the render loop.
+	void set(Uniform<bool> uniform, bool value) const
+	{
+		glUniform1i(uniform.Location, (int)value);
+	}
+
+	void set(Uniform<int> uniform, int value) const
+	{
+		glUniform1i(uniform.Location, value);
+	}
+
+	void set(Uniform<float> uniform, float value) const
+	{
+		glUniform1f(uniform.Location, value);
+	}
+
+	void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+	{
+		glUniform3fv(uniform.Location, 1, glm::value_ptr(value));
+	}
+
+	void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+	{
+		glUniform4fv(uniform.Location, 1, glm::value_ptr(value));
+	}
+
+	void set(Uniform<glm::mat4> uniform, const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(uniform.Location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	// Set uniform bool value.
+	void setBool(const std::string& name, bool value) const
+	{
+		glUniform1i(getUniformLocation(name.c_str()), (int)value);
+	}
+
+	// Set uniform int value.
+	void setInt(const std::string& name, int value) const
+	{
+		glUniform1i(getUniformLocation(name.c_str()), value);
+	}
+
+	// Set uniform float value.
+	void setFloat(const std::string& name, float value) const
+	{
+		glUniform1f(getUniformLocation(name.c_str()), value);
+	}
+
+	void setMat4(const std::string& name, const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(getUniformLocation(name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+private:
+	ShaderCache* cache;
+
+	// The program being built, from submit() until complete().
+	bool pending;
+	bool loadedFromCache;
+	unsigned int vertex, fragment;
+	std::string cacheKey;
+
+	// Time the build took the calling thread: the compile and link calls, and the wait for their results in complete().
+	// The time in between, when other work runs while the driver builds, isn't the program's, so it isn't counted.
+	double buildSeconds;
+
+	// Uniform lookups need the reflected uniforms, so they finish the program first. finish() only changes what the program
+	// would have looked like had it been finished in the constructor, so it's fine to call on a const shader.
+	void ensureFinished() const
+	{
+		if (pending)
+			const_cast<Shader*>(this)->finish();
+	}
+
+	// Load a program from the cache, or hand its sources to the compiler and linker, without waiting for either.
+	void submit(const std::string& vertexCode, const std::string& fragmentCode, unsigned int& program)
+	{
+		// Try to load the program binary from the cache first.
+		loadedFromCache = false;
+		cacheKey.clear();
+		if (cache && cache->isEnabled())
+		{
+			cacheKey = cache->key(vertexCode, fragmentCode);
+			program = glCreateProgram();
+			if (cache->load(program, cacheKey))
+			{
+				loadedFromCache = true;
+				return;
+			}
+
+			// Start over with a fresh program, a rejected binary may leave the program in an unusable state.
+			glDeleteProgram(program);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
 
-		// Compile an link shaders.
-		unsigned int vertex, fragment;
-		int success;
-		char infoLog[512];
+		// Compile an link shaders. The results are only checked in complete().
 
 		// Vertex shader.
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vShaderCode, NULL);
 		glCompileShader(vertex);
+
+		// Fragment shader.
+		fragment = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragment, 1, &fShaderCode, NULL);
+		glCompileShader(fragment);
+
+		// Shader program.
+		program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		if (cache)
+			cache->prepare(program);
+		glLinkProgram(program);
+		buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Wait for the submitted program, and check whether it compiled and linked. Returns false if it didn't.
+	bool complete(unsigned int program)
+	{
+		if (loadedFromCache)
+			return true;
+
+		// Asking for the results waits for whatever the driver hasn't built yet.
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int success;
+		bool compiled = true;
+		char infoLog[512];
+
 		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
 		if (!success)
 		{
 			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+			compiled = false;
 		}
 
-		// Fragment shader.
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
 		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
 		if (!success)
 		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			compiled = false;
 		}
 
-		// Shader program.
-		Id = glCreateProgram();
-		glAttachShader(Id, vertex);
-		glAttachShader(Id, fragment);
-		glLinkProgram(Id);
-		glGetProgramiv(Id, GL_LINK_STATUS, &success);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		buildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 		if (!success)
 		{
-			glGetProgramInfoLog(Id, 512, NULL, infoLog);
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
 			std::cout << "ERROR:SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		else if (cache)
+		{
+			cache->store(program, cacheKey, buildSeconds);
+		}
 
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+		return compiled && success;
 	}
 
-	// Use/activate the shader.
-	void use()
+	// Query all active uniforms of the linked program into the Uniforms table.
+	void reflectUniforms()
 	{
-		glUseProgram(Id);
-	}
+		int count = 0, maxLength = 0;
+		glGetProgramiv(Id, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(Id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
 
-	// Set uniform bool value.
-	void setBool(const std::string& name, bool value) const
-	{
-		glUniform1i(glGetUniformLocation(Id, name.c_str()), (int)value);
-	}
+		std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+		for (int i = 0; i < count; i++)
+		{
+			UniformInfo info;
+			int length = 0;
+			glGetActiveUniform(Id, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &info.Size, &info.Type, nameBuffer.data());
+			info.Name.assign(nameBuffer.data(), length);
 
-	// Set uniform int value.
-	void setInt(const std::string& name, int value) const
-	{
-		glUniform1i(glGetUniformLocation(Id, name.c_str()), value);
-	}
+			// Uniforms inside uniform blocks don't have a location, they're set through buffers instead.
+			info.Location = glGetUniformLocation(Id, info.Name.c_str());
+			if (info.Location == -1)
+				continue;
 
-	// Set uniform float value.
-	void setFloat(const std::string& name, float value) const
-	{
-		glUniform1f(glGetUniformLocation(Id, name.c_str()), value);
+			// Arrays are reported as "name[0]", but are usually addressed by their plain name.
+			if (info.Name.size() > 3 && info.Name.compare(info.Name.size() - 3, 3, "[0]") == 0)
+				info.Name.erase(info.Name.size() - 3);
+
+			Uniforms.push_back(info);
+		}
+
+		std::sort(Uniforms.begin(), Uniforms.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.Name < b.Name; });
 	}
 
-	void setMat4(const std::string& name, const glm::mat4 value) const
+	// Connect every uniform block of the linked program to the binding point its buffer is bound to (see UniformBuffer.h).
+	// Block bindings are part of the program object's state, so this has to happen after every link, including loading a cached binary.
+	void bindUniformBlocks()
 	{
-		glUniformMatrix4fv(glGetUniformLocation(Id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+		int count = 0, maxLength = 0;
+		glGetProgramiv(Id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(Id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+
+		std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+		for (int i = 0; i < count; i++)
+		{
+			glGetActiveUniformBlockName(Id, (GLuint)i, (GLsizei)nameBuffer.size(), NULL, nameBuffer.data());
+			int binding = uniformBlockBinding(nameBuffer.data());
+			if (binding == -1)
+			{
+				std::cout << "WARNING::SHADER::UNKNOWN_UNIFORM_BLOCK " << nameBuffer.data() << std::endl;
+				continue;
+			}
+			glUniformBlockBinding(Id, (GLuint)i, (GLuint)binding);
+		}
 	}
 };
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// On-disk cache of linked shader programs.
+// Compiling and linking GLSL from source is slow, so after a program has been linked the first time, we ask the driver for
+// the program binary (glGetProgramBinary) and store it on disk. On the next launch the binary is loaded straight into the program
+// (glProgramBinary), skipping the compiler entirely.
+// Binaries are only valid for the exact driver that produced them, so the cache key combines the shader sources with the
+// vendor, renderer and version strings. Even then a driver may reject a binary, in which case we simply compile again.
+class ShaderCache
+{
+public:
+	std::string Directory;
+
+	// Statistics of this run.
+	int Hits, Misses, Rejected;
+	double SecondsSaved;
+
+	// An empty directory disables the cache.
+	ShaderCache(const std::string& directory) : Directory(directory), Hits(0), Misses(0), Rejected(0), SecondsSaved(0.0)
+	{
+		if (directory.empty())
+			return;
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+
+	// Program binaries need driver support, without it the cache does nothing.
+	bool isEnabled() const
+	{
+		return !Directory.empty() && glExtensions().ProgramBinary;
+	}
+
+	// Cache key of a program built from the given sources by the current driver.
+	std::string key(const std::string& vertexCode, const std::string& fragmentCode) const
+	{
+		uint64_t hash = 14695981039346656037ull;
+		hashString(hash, vertexCode);
+		hashString(hash, fragmentCode);
+		hashString(hash, (const char*)glGetString(GL_VENDOR));
+		hashString(hash, (const char*)glGetString(GL_RENDERER));
+		hashString(hash, (const char*)glGetString(GL_VERSION));
+
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+		return name;
+	}
+
+	// Must be called before linking a program that should be stored in the cache afterwards.
+	void prepare(unsigned int program) const
+	{
+		if (isEnabled())
+			glExtensions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Try to load the program binary stored under key into program. Returns true if the program is linked and ready to use.
+	bool load(unsigned int program, const std::string& key)
+	{
+		if (!isEnabled())
+			return false;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::ifstream file(path(key).c_str(), std::ios::binary);
+		FileHeader header;
+		if (!file || !file.read((char*)&header, sizeof(header)) || header.Magic != Magic)
+		{
+			Misses++;
+			return false;
+		}
+
+		// The length comes from the file, so a truncated or corrupt file must not make us allocate whatever it says: the binary
+		// has to fill exactly the rest of the file.
+		std::streamoff binaryStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		std::streamoff fileSize = file.tellg();
+		file.seekg(binaryStart);
+		if (!file || binaryStart < 0 || fileSize - binaryStart != (std::streamoff)header.Length)
+		{
+			Rejected++;
+			return false;
+		}
+
+		std::vector<char> binary(header.Length);
+		if (!file.read(binary.data(), binary.size()))
+		{
+			Rejected++;
+			return false;
+		}
+
+		glExtensions().ProgramBinaryLoad(program, header.Format, binary.data(), (GLsizei)binary.size());
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// Usually a driver update, the binary will be replaced once the program has been compiled again.
+			Rejected++;
+			return false;
+		}
+
+		Hits++;
+		SecondsSaved += header.CompileSeconds - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	// Store the binary of a successfully linked program under key, together with how long building it kept us waiting: the compile
+	// and link calls, and the wait for their results.
+	void store(unsigned int program, const std::string& key, double compileSeconds) const
+	{
+		if (!isEnabled())
+			return;
+
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<char> binary(length);
+		FileHeader header;
+		header.Magic = Magic;
+		header.CompileSeconds = compileSeconds;
+		glExtensions().GetProgramBinary(program, length, NULL, &header.Format, binary.data());
+		header.Length = (uint32_t)length;
+
+		std::ofstream file(path(key).c_str(), std::ios::binary);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), binary.size());
+		if (!file)
+			std::cout << "WARNING::SHADER_CACHE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path(key) << std::endl;
+	}
+
+	void printStatistics(std::ostream& out) const
+	{
+		if (Directory.empty())
+		{
+			out << "Shader cache: disabled" << std::endl;
+			return;
+		}
+		if (!isEnabled())
+		{
+			out << "Shader cache: program binaries are not supported by the driver" << std::endl;
+			return;
+		}
+
+		out << "Shader cache: " << Hits << " hits, " << Misses << " misses, " << Rejected << " rejected, "
+			<< SecondsSaved * 1000.0 << " ms saved" << std::endl;
+	}
+
+private:
+	static const uint32_t Magic = 0x42504C47; // "GLPB"
+
+	struct FileHeader
+	{
+		uint32_t Magic;
+		GLenum Format;
+		uint32_t Length;
+		double CompileSeconds;
+	};
+
+	std::string path(const std::string& key) const
+	{
+		return Directory + "/" + key + ".bin";
+	}
+
+	// 64-bit FNV-1a, including the terminating zero so "ab" + "c" and "a" + "bc" hash differently.
+	static void hashString(uint64_t& hash, const std::string& text)
+	{
+		for (size_t i = 0; i <= text.size(); i++)
+			hash = (hash ^ (unsigned char)text.c_str()[i]) * 1099511628211ull;
+	}
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "Shader.h"
+#include "ShaderCache.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Builds all shaders of the playground at once.
+// Checking GL_COMPILE_STATUS right after glCompileShader makes the driver finish that shader before it even sees the next one, so
+// compiling shaders one by one keeps a single core busy. Instead, the library submits every compile and link up front (see Shader),
+// and only checks them later, which lets a driver with GL_KHR_parallel_shader_compile build them all on its own threads at once,
+// while the application does other work (e.g. loading meshes and textures).
+// poll() finishes the programs the driver reports done (GL_COMPLETION_STATUS_KHR) without ever blocking, and finish() waits for the rest.
+// Without the extension the driver still gets to work on the next shader while we submit it, and every program is finished in order.
+class ShaderLibrary
+{
+public:
+	std::vector<Shader*> Shaders;
+
+	explicit ShaderLibrary(ShaderCache* cache = NULL) : cache(cache), started(false), seconds(0.0)
+	{
+	}
+
+	// The library owns its shaders, so they're deleted on every way out, including early returns on errors.
+	~ShaderLibrary()
+	{
+		destroy();
+	}
+
+	// Let the driver use as many compiler threads as it likes. Must be called with the context current, before any shader is loaded.
+	void create()
+	{
+		if (glExtensions().ParallelShaderCompile)
+			glExtensions().MaxShaderCompilerThreads(0xFFFFFFFFu);
+	}
+
+	// Read a shader and start building it. The shader can be used right away, its first use waits for it if it isn't done yet.
+	Shader* load(const char* vertexPath, const char* fragmentPath)
+	{
+		if (!started)
+		{
+			start = std::chrono::steady_clock::now();
+			started = true;
+		}
+
+		Shader* shader = new Shader(vertexPath, fragmentPath, cache);
+		Shaders.push_back(shader);
+		return shader;
+	}
+
+	// Number of shaders that are still being built.
+	int pending() const
+	{
+		int count = 0;
+		for (size_t i = 0; i < Shaders.size(); i++)
+		{
+			if (Shaders[i]->isPending())
+				count++;
+		}
+		return count;
+	}
+
+	// Finish the shaders the driver is done with, without waiting. Returns the number of shaders finished.
+	int poll()
+	{
+		int finished = 0;
+		for (size_t i = 0; i < Shaders.size(); i++)
+		{
+			if (Shaders[i]->isPending() && Shaders[i]->isReady())
+			{
+				Shaders[i]->finish();
+				finished++;
+			}
+		}
+		updateTime();
+		return finished;
+	}
+
+	// Wait for all shaders to be built. The ones that are done are finished first, so we only wait on the ones that aren't.
+	void finish()
+	{
+		poll();
+		for (size_t i = 0; i < Shaders.size(); i++)
+			Shaders[i]->finish();
+		updateTime();
+	}
+
+	void printStatistics(std::ostream& out) const
+	{
+		out << "Shader library: " << Shaders.size() << " programs built in " << seconds * 1000.0 << " ms ("
+			<< (glExtensions().ParallelShaderCompile ? "parallel compile" : "no parallel compile support") << ")" << std::endl;
+	}
+
+	// Delete the shader objects. Their programs are released with the context, so this is safe to call after it was destroyed.
+	void destroy()
+	{
+		for (size_t i = 0; i < Shaders.size(); i++)
+			delete Shaders[i];
+		Shaders.clear();
+	}
+
+private:
+	ShaderCache* cache;
+	bool started;
+	std::chrono::steady_clock::time_point start;
+
+	// Time from the first load to the last shader being finished.
+	double seconds;
+
+	void updateTime()
+	{
+		if (started && pending() == 0 && seconds == 0.0)
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// A copy would delete the same shaders again.
+	ShaderLibrary(const ShaderLibrary&);
+	ShaderLibrary& operator=(const ShaderLibrary&);
+};
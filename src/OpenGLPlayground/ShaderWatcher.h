@@ -0,0 +1,237 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reloads shaders while the playground runs, whenever their source files are saved.
+// A background thread waits for the file system to report changes (inotify), and reads the changed sources right away, so the render
+// thread never touches the disk. Compiling and linking need the OpenGL context, so those happen on the render thread in update(),
+// which swaps the new program into the Shader between two frames. A shader with errors keeps its previous program, so a typo doesn't
+// take the renderer down: fix it, save again, and the next update() picks it up.
+// Editors often save by writing a new file and renaming it over the old one, so the directories are watched rather than the files.
+class ShaderWatcher
+{
+public:
+	// Number of successful and failed reloads so far.
+	int Reloaded;
+	int Failed;
+
+	ShaderWatcher() : Reloaded(0), Failed(0), running(false), inotify(-1)
+	{
+	}
+
+	~ShaderWatcher()
+	{
+		stop();
+	}
+
+	// Reload the shader whenever one of its source files changes. Call before start().
+	void watch(Shader* shader)
+	{
+		shaders.push_back(shader);
+		addFile(shader->VertexPath);
+		addFile(shader->FragmentPath);
+	}
+
+	// Start watching the files of the watched shaders. Only supported on Linux.
+	bool start()
+	{
+#ifdef __linux__
+		inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotify < 0)
+		{
+			std::cout << "ERROR::SHADER_WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+			return false;
+		}
+
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			// Directories shared by several files return the same watch descriptor.
+			files[i].Watch = inotify_add_watch(inotify, files[i].Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (files[i].Watch < 0)
+				std::cout << "ERROR::SHADER_WATCHER::CANNOT_WATCH " << files[i].Directory << std::endl;
+		}
+
+		running = true;
+		thread = std::thread(&ShaderWatcher::watcherMain, this);
+		std::cout << "Watching " << files.size() << " shader files for changes" << std::endl;
+		return true;
+#else
+		std::cout << "ERROR::SHADER_WATCHER::NOT_SUPPORTED shader hot reload needs inotify (Linux)" << std::endl;
+		return false;
+#endif
+	}
+
+	void stop()
+	{
+		if (running)
+		{
+			running = false;
+			thread.join();
+		}
+#ifdef __linux__
+		if (inotify >= 0)
+			close(inotify);
+#endif
+		inotify = -1;
+	}
+
+	// Rebuild the shaders whose sources changed since the last call. Must be called on the thread owning the OpenGL context,
+	// between frames. Returns the number of shaders that were replaced by a new program, whose uniforms have to be set again.
+	int update()
+	{
+		std::vector<ChangedFile> changed;
+		{
+			std::lock_guard<std::mutex> lock(changedMutex);
+			if (pending.empty())
+				return 0;
+			changed.swap(pending);
+		}
+
+		int reloaded = 0;
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			Shader* shader = shaders[i];
+			std::string vertexCode = shader->VertexCode;
+			std::string fragmentCode = shader->FragmentCode;
+			bool affected = false;
+			for (size_t j = 0; j < changed.size(); j++)
+			{
+				if (changed[j].Path == shader->VertexPath)
+					vertexCode = changed[j].Source;
+				else if (changed[j].Path == shader->FragmentPath)
+					fragmentCode = changed[j].Source;
+				else
+					continue;
+				affected = true;
+			}
+
+			// Saving a file without changing it (or touching it) doesn't need a new program.
+			if (!affected || (vertexCode == shader->VertexCode && fragmentCode == shader->FragmentCode))
+				continue;
+
+			if (shader->reload(vertexCode, fragmentCode))
+			{
+				std::cout << "Reloaded shader " << shader->VertexPath << " + " << shader->FragmentPath << std::endl;
+				Reloaded++;
+				reloaded++;
+			}
+			else
+			{
+				Failed++;
+			}
+		}
+		return reloaded;
+	}
+
+private:
+	// A watched source file, split up the way inotify reports it: the watched directory and the file name within.
+	struct WatchedFile
+	{
+		std::string Path;
+		std::string Directory;
+		std::string Name;
+		int Watch;
+	};
+
+	// The new source of a file, read on the watcher thread.
+	struct ChangedFile
+	{
+		std::string Path;
+		std::string Source;
+	};
+
+	std::vector<Shader*> shaders;
+	std::vector<WatchedFile> files;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	int inotify;
+
+	std::mutex changedMutex;
+	std::vector<ChangedFile> pending;
+
+	void addFile(const std::string& path)
+	{
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (files[i].Path == path)
+				return;
+		}
+
+		WatchedFile file;
+		file.Path = path;
+		size_t slash = path.find_last_of('/');
+		file.Directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+		file.Name = slash == std::string::npos ? path : path.substr(slash + 1);
+		file.Watch = -1;
+		files.push_back(file);
+	}
+
+	void watcherMain()
+	{
+#ifdef __linux__
+		// Events are variable length (they end in the file name), and the buffer has to be aligned like the event struct.
+		alignas(struct inotify_event) char buffer[4096];
+		while (running)
+		{
+			// Wake up regularly to check whether we should stop.
+			struct pollfd descriptor = { inotify, POLLIN, 0 };
+			if (poll(&descriptor, 1, 100) <= 0)
+				continue;
+
+			ssize_t length = read(inotify, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+				if (event->len == 0)
+					continue;
+
+				for (size_t i = 0; i < files.size(); i++)
+				{
+					if (files[i].Watch == event->wd && files[i].Name == event->name)
+						readChangedFile(files[i].Path);
+				}
+			}
+		}
+#endif
+	}
+
+	void readChangedFile(const std::string& path)
+	{
+		std::ifstream file(path.c_str());
+		if (!file)
+			return;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+
+		// A file saved several times before the render thread got to it only has to be rebuilt with its latest source.
+		std::lock_guard<std::mutex> lock(changedMutex);
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			if (pending[i].Path == path)
+			{
+				pending[i].Source = stream.str();
+				return;
+			}
+		}
+		ChangedFile changed = { path, stream.str() };
+		pending.push_back(changed);
+	}
+};
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <glm/simd/common.h>
+#endif
+
+// A texture in CPU memory, sampled by the software rasterizer like OpenGL samples the cube's textures:
+// GL_REPEAT wrapping and bilinear filtering (without mipmaps).
+struct SoftwareTexture
+{
+	int Width, Height, Channels;
+	std::vector<unsigned char> Pixels;
+
+	SoftwareTexture() : Width(0), Height(0), Channels(0)
+	{
+	}
+
+	// Load an image with stb_image, flipped the same way as the OpenGL textures (see stbi_set_flip_vertically_on_load).
+	bool load(const char* path)
+	{
+		unsigned char* data = stbi_load(path, &Width, &Height, &Channels, 0);
+		if (!data)
+		{
+			std::cout << "Failed to load texture " << path << std::endl;
+			return false;
+		}
+
+		Pixels.assign(data, data + (size_t)Width * Height * Channels);
+		stbi_image_free(data);
+		return true;
+	}
+
+	glm::vec4 sample(float u, float v) const
+	{
+		if (Pixels.empty())
+			return glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+
+		// Texel centers are at half coordinates, so shift by half a texel before splitting into the integer and fractional part.
+		float x = u * Width - 0.5f;
+		float y = v * Height - 0.5f;
+		float x0 = floor(x);
+		float y0 = floor(y);
+		float fx = x - x0;
+		float fy = y - y0;
+
+		glm::vec4 top = glm::mix(texel((int)x0, (int)y0), texel((int)x0 + 1, (int)y0), fx);
+		glm::vec4 bottom = glm::mix(texel((int)x0, (int)y0 + 1), texel((int)x0 + 1, (int)y0 + 1), fx);
+		return glm::mix(top, bottom, fy);
+	}
+
+private:
+	glm::vec4 texel(int x, int y) const
+	{
+		x %= Width;
+		y %= Height;
+		if (x < 0)
+			x += Width;
+		if (y < 0)
+			y += Height;
+
+		const unsigned char* p = &Pixels[((size_t)y * Width + x) * Channels];
+		glm::vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+		for (int c = 0; c < Channels && c < 4; c++)
+			color[c] = p[c] / 255.0f;
+		return color;
+	}
+};
+
+// Renders the cube scene on the CPU, as a reference renderer that doesn't need a GPU (or OpenGL at all).
+// It consumes the same vertex layout as the VAO (position + texture coordinates, 5 floats per vertex) and the same matrices,
+// and shades every pixel like shader.fs does. Rendering a frame happens in two steps:
+//	1. draw() transforms and clips the triangles on the calling thread, and sorts (bins) them into the screen tiles they overlap.
+//	2. endFrame() rasterizes the tiles in parallel. Each tile is owned by one thread at a time, so the threads never write the same pixel,
+//	   and every tile draws its triangles in submission order, so the image doesn't depend on the number of threads.
+// Like OpenGL, the color buffer stores its rows bottom to top.
+class SoftwareRasterizer
+{
+public:
+	// Size of the square screen tiles, in pixels.
+	static const int TileSize = 64;
+
+	int Width, Height;
+	std::vector<unsigned char> Color;	// RGBA
+	std::vector<float> Depth;
+
+	// Statistics of the last frame.
+	int Triangles;
+	int BinnedTriangles;
+
+	SoftwareRasterizer(int width, int height, int threadCount = 0)
+		: Width(width), Height(height), Triangles(0), BinnedTriangles(0), generation(0), stopping(false), nextTile(0), busyWorkers(0)
+	{
+		textures[0] = textures[1] = NULL;
+		Color.resize((size_t)width * height * 4);
+		Depth.resize((size_t)width * height);
+
+		tilesX = (width + TileSize - 1) / TileSize;
+		tilesY = (height + TileSize - 1) / TileSize;
+		bins.resize(tilesX * tilesY);
+
+		if (threadCount <= 0)
+			threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount < 1)
+			threadCount = 1;
+
+		// The thread calling endFrame() rasterizes tiles too, so it only needs threadCount - 1 helpers.
+		for (int i = 1; i < threadCount; i++)
+			workers.push_back(std::thread(&SoftwareRasterizer::workerMain, this));
+	}
+
+	~SoftwareRasterizer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		workStarted.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	// Number of threads rasterizing tiles, including the one calling endFrame().
+	int threadCount() const
+	{
+		return (int)workers.size() + 1;
+	}
+
+	// Bind the textures shader.fs samples as texture1 and texture2.
+	void setTextures(const SoftwareTexture* texture1, const SoftwareTexture* texture2)
+	{
+		textures[0] = texture1;
+		textures[1] = texture2;
+	}
+
+	// Start a new frame, clearing the color buffer to clearColor and the depth buffer to 1 (the far plane).
+	void beginFrame(const glm::vec4& clearColor)
+	{
+		for (int c = 0; c < 4; c++)
+			clear[c] = toByte(clearColor[c]);
+
+		triangles.clear();
+		for (size_t i = 0; i < bins.size(); i++)
+			bins[i].clear();
+		Triangles = 0;
+		BinnedTriangles = 0;
+	}
+
+	// Draw a non-indexed triangle list (like glDrawArrays(GL_TRIANGLES, ...)) transformed by the given model-view-projection matrix.
+	void draw(const float* vertices, int vertexCount, int stride, const glm::mat4& modelViewProjection)
+	{
+		for (int i = 0; i + 2 < vertexCount; i += 3)
+		{
+			ClipVertex polygon[MaxClipVertices];
+			for (int v = 0; v < 3; v++)
+			{
+				const float* vertex = vertices + (size_t)(i + v) * stride;
+				polygon[v].Position = modelViewProjection * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+				polygon[v].TexCoord = glm::vec2(vertex[3], vertex[4]);
+			}
+			Triangles++;
+
+			// Clip to the view volume, which turns the triangle into a convex polygon of up to 9 vertices, and draw it as a triangle fan.
+			int count = clip(polygon, 3);
+			for (int v = 1; v + 1 < count; v++)
+				setupTriangle(polygon[0], polygon[v], polygon[v + 1]);
+		}
+	}
+
+	// Rasterize all triangles drawn since beginFrame(), spread over all threads. Returns once the frame is complete.
+	void endFrame()
+	{
+		nextTile = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers = (int)workers.size();
+			generation++;
+		}
+		workStarted.notify_all();
+
+		rasterizeTiles();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		workFinished.wait(lock, [this] { return busyWorkers == 0; });
+	}
+
+private:
+	static const int MaxClipVertices = 9;
+
+	struct ClipVertex
+	{
+		glm::vec4 Position;
+		glm::vec2 TexCoord;
+	};
+
+	// A triangle ready for rasterization.
+	// Each edge function E(x, y) = A * x + B * y + C is positive on the inside of the edge opposite its vertex, and divided by the
+	// triangle's area it's that vertex's barycentric coordinate. Depth is linear in screen space, the texture coordinates are
+	// interpolated divided by w (together with 1 / w), which makes them perspective correct.
+	struct Triangle
+	{
+		float A[3], B[3], C[3];
+		bool TopLeft[3];
+		float Z[3];
+		float InvW[3];
+		glm::vec2 TexCoordOverW[3];
+		int MinX, MinY, MaxX, MaxY;
+	};
+
+	int tilesX, tilesY;
+	const SoftwareTexture* textures[2];
+	unsigned char clear[4];
+
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<unsigned int> > bins;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable workStarted;
+	std::condition_variable workFinished;
+	unsigned int generation;
+	bool stopping;
+	std::atomic<int> nextTile;
+	int busyWorkers;
+
+	static unsigned char toByte(float value)
+	{
+		return (unsigned char)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Sutherland-Hodgman clipping against the 6 planes of the clip volume (-w <= x, y, z <= w). Returns the new vertex count.
+	static int clip(ClipVertex* polygon, int count)
+	{
+		for (int plane = 0; plane < 6 && count > 0; plane++)
+		{
+			ClipVertex input[MaxClipVertices];
+			std::copy(polygon, polygon + count, input);
+			int output = 0;
+
+			for (int i = 0; i < count; i++)
+			{
+				const ClipVertex& current = input[i];
+				const ClipVertex& next = input[(i + 1) % count];
+				float currentDistance = planeDistance(current.Position, plane);
+				float nextDistance = planeDistance(next.Position, plane);
+
+				if (currentDistance >= 0.0f)
+					polygon[output++] = current;
+
+				// The edge crosses the plane, add the intersection.
+				if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+				{
+					float t = currentDistance / (currentDistance - nextDistance);
+					polygon[output].Position = glm::mix(current.Position, next.Position, t);
+					polygon[output].TexCoord = glm::mix(current.TexCoord, next.TexCoord, t);
+					output++;
+				}
+			}
+
+			count = output;
+		}
+		return count;
+	}
+
+	// Distance to one of the clip planes, positive on the inside: w + x, w - x, w + y, w - y, w + z and w - z.
+	static float planeDistance(const glm::vec4& position, int plane)
+	{
+		float value = position[plane / 2];
+		return plane % 2 == 0 ? position.w + value : position.w - value;
+	}
+
+	// Project a clipped triangle to the screen, compute its edge functions and add it to the bins of the tiles it overlaps.
+	void setupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+	{
+		const ClipVertex* vertices[3] = { &v0, &v1, &v2 };
+		glm::vec2 screen[3];
+		Triangle triangle;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& position = vertices[i]->Position;
+			float invW = 1.0f / position.w;
+
+			// Viewport transform (like glViewport(0, 0, Width, Height)) and depth range [0, 1].
+			screen[i] = glm::vec2((position.x * invW * 0.5f + 0.5f) * Width, (position.y * invW * 0.5f + 0.5f) * Height);
+			triangle.Z[i] = position.z * invW * 0.5f + 0.5f;
+			triangle.InvW[i] = invW;
+			triangle.TexCoordOverW[i] = vertices[i]->TexCoord * invW;
+		}
+
+		// Face culling isn't enabled, so both windings are drawn. Swap two vertices of clockwise triangles to make all edge functions positive inside.
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (area == 0.0f)
+			return;
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			std::swap(triangle.Z[1], triangle.Z[2]);
+			std::swap(triangle.InvW[1], triangle.InvW[2]);
+			std::swap(triangle.TexCoordOverW[1], triangle.TexCoordOverW[2]);
+			area = -area;
+		}
+
+		// Edge i runs between the two vertices other than i. Dividing by the area here gives the barycentric coordinates directly.
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec2& a = screen[(i + 1) % 3];
+			const glm::vec2& b = screen[(i + 2) % 3];
+			triangle.A[i] = (a.y - b.y) / area;
+			triangle.B[i] = (b.x - a.x) / area;
+			triangle.C[i] = (a.x * b.y - a.y * b.x) / area;
+
+			// Top-left fill rule: a pixel center exactly on an edge belongs to the triangle only for top and left edges,
+			// so pixels on an edge shared by two triangles are drawn exactly once.
+			triangle.TopLeft[i] = (a.y == b.y && b.x < a.x) || b.y < a.y;
+		}
+
+		// Pixels whose center lies within the bounding box.
+		float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+		float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+		float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+		float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+		triangle.MinX = std::max(0, (int)ceil(minX - 0.5f));
+		triangle.MaxX = std::min(Width - 1, (int)floor(maxX - 0.5f));
+		triangle.MinY = std::max(0, (int)ceil(minY - 0.5f));
+		triangle.MaxY = std::min(Height - 1, (int)floor(maxY - 0.5f));
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+			return;
+
+		unsigned int index = (unsigned int)triangles.size();
+		triangles.push_back(triangle);
+		BinnedTriangles++;
+
+		for (int tileY = triangle.MinY / TileSize; tileY <= triangle.MaxY / TileSize; tileY++)
+			for (int tileX = triangle.MinX / TileSize; tileX <= triangle.MaxX / TileSize; tileX++)
+				bins[tileY * tilesX + tileX].push_back(index);
+	}
+
+	void workerMain()
+	{
+		unsigned int seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				workStarted.wait(lock, [this, seen] { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+
+			rasterizeTiles();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busyWorkers--;
+			}
+			workFinished.notify_one();
+		}
+	}
+
+	// Take tiles off the shared counter until all tiles of the frame are done.
+	void rasterizeTiles()
+	{
+		const int tileCount = tilesX * tilesY;
+		for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			rasterizeTile(tile);
+	}
+
+	void rasterizeTile(int tile)
+	{
+		int x0 = (tile % tilesX) * TileSize;
+		int y0 = (tile / tilesX) * TileSize;
+		int x1 = std::min(x0 + TileSize, Width) - 1;
+		int y1 = std::min(y0 + TileSize, Height) - 1;
+
+		// Clear the tile's part of the buffers while it's hot in this core's cache.
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				size_t pixel = (size_t)y * Width + x;
+				std::copy(clear, clear + 4, &Color[pixel * 4]);
+				Depth[pixel] = 1.0f;
+			}
+		}
+
+		const std::vector<unsigned int>& bin = bins[tile];
+		for (size_t i = 0; i < bin.size(); i++)
+		{
+			const Triangle& triangle = triangles[bin[i]];
+			int minX = std::max(x0, triangle.MinX);
+			int maxX = std::min(x1, triangle.MaxX);
+			int minY = std::max(y0, triangle.MinY);
+			int maxY = std::min(y1, triangle.MaxY);
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				// 4 horizontally adjacent pixels per step. Lanes past maxX are masked out.
+				for (int x = minX; x <= maxX; x += 4)
+				{
+					float barycentric[3][4];
+					int mask = coverage(triangle, x, y, barycentric) & laneMask(maxX - x + 1);
+					while (mask)
+					{
+						int lane = 0;
+						while (!(mask & (1 << lane)))
+							lane++;
+						mask &= mask - 1;
+						shade(triangle, x + lane, y, barycentric[0][lane], barycentric[1][lane], barycentric[2][lane]);
+					}
+				}
+			}
+		}
+	}
+
+	// Without a texture bound, sample the same grey the texture loader's placeholders show.
+	static glm::vec4 sample(const SoftwareTexture* texture, const glm::vec2& texCoord)
+	{
+		return texture ? texture->sample(texCoord.x, texCoord.y) : glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	}
+
+	static int laneMask(int remaining)
+	{
+		return remaining >= 4 ? 0xF : (1 << remaining) - 1;
+	}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	// Evaluate the 3 edge functions for pixels (x..x+3, y) at once. Returns a bit per pixel inside the triangle.
+	static int coverage(const Triangle& triangle, int x, int y, float barycentric[3][4])
+	{
+		const glm_vec4 px = _mm_setr_ps(x + 0.5f, x + 1.5f, x + 2.5f, x + 3.5f);
+		const glm_vec4 py = _mm_set1_ps(y + 0.5f);
+		const glm_vec4 zero = _mm_setzero_ps();
+
+		glm_vec4 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int i = 0; i < 3; i++)
+		{
+			glm_vec4 e = glm_vec4_add(glm_vec4_mul(_mm_set1_ps(triangle.A[i]), px), glm_vec4_mul(_mm_set1_ps(triangle.B[i]), py));
+			e = glm_vec4_add(e, _mm_set1_ps(triangle.C[i]));
+			_mm_storeu_ps(barycentric[i], e);
+
+			glm_vec4 edgeInside = triangle.TopLeft[i] ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+			inside = _mm_and_ps(inside, edgeInside);
+		}
+		return _mm_movemask_ps(inside);
+	}
+#else
+	static int coverage(const Triangle& triangle, int x, int y, float barycentric[3][4])
+	{
+		int mask = 0;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			bool inside = true;
+			for (int i = 0; i < 3; i++)
+			{
+				float e = triangle.A[i] * (x + lane + 0.5f) + triangle.B[i] * (y + 0.5f) + triangle.C[i];
+				barycentric[i][lane] = e;
+				inside = inside && (triangle.TopLeft[i] ? e >= 0.0f : e > 0.0f);
+			}
+			if (inside)
+				mask |= 1 << lane;
+		}
+		return mask;
+	}
+#endif
+
+	// Depth test (GL_LESS) and shade a single pixel, like shader.fs: 80% texture1 mixed with 20% texture2.
+	void shade(const Triangle& triangle, int x, int y, float b0, float b1, float b2)
+	{
+		size_t pixel = (size_t)y * Width + x;
+		float z = b0 * triangle.Z[0] + b1 * triangle.Z[1] + b2 * triangle.Z[2];
+		if (!(z < Depth[pixel]))
+			return;
+		Depth[pixel] = z;
+
+		float w = 1.0f / (b0 * triangle.InvW[0] + b1 * triangle.InvW[1] + b2 * triangle.InvW[2]);
+		glm::vec2 texCoord = (b0 * triangle.TexCoordOverW[0] + b1 * triangle.TexCoordOverW[1] + b2 * triangle.TexCoordOverW[2]) * w;
+
+		glm::vec4 color = glm::mix(sample(textures[0], texCoord), sample(textures[1], texCoord), 0.2f);
+		unsigned char* out = &Color[pixel * 4];
+		for (int c = 0; c < 4; c++)
+			out[c] = toByte(color[c]);
+	}
+};
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "RenderState.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Ring buffer for data the CPU writes every frame and the GPU reads once (model matrices, particles, UI vertices).
+// Re-specifying a buffer with glBufferData every frame (orphaning) makes the driver allocate new storage each time, and a plain
+// glBufferSubData or glMapBuffer has to wait until the GPU is done with the old contents. Instead, one buffer is created once
+// and split into a region per frame in flight: while the GPU still reads the previous frames' regions, the CPU writes the next one.
+// A fence is placed after the last draw reading a region, and before the region is written again, the CPU waits on that fence.
+// With enough regions the fence has long been signaled by then, so that wait (a stall) should practically never happen.
+//
+// With GL_ARB_buffer_storage (OpenGL 4.4) the buffer is mapped once and stays mapped for its whole lifetime (persistent mapping),
+// writes go straight into memory the GPU reads from. On plain OpenGL 3.3 every write maps its range with GL_MAP_UNSYNCHRONIZED_BIT,
+// which tells the driver not to synchronize with the GPU (the fences already do), and GL_MAP_INVALIDATE_RANGE_BIT, so the old
+// contents don't have to be read back.
+class StreamBuffer
+{
+public:
+	// Number of frames the CPU can be ahead of the GPU. Triple buffering: one region being read by the GPU,
+	// one queued up in the driver, and one being written.
+	static const int RegionCount = 3;
+
+	unsigned int Buffer;
+	GLenum Target;
+
+	// Size of every region in bytes, i.e. the most data that can be streamed per frame.
+	GLsizeiptr RegionSize;
+
+	// Whether the buffer is persistently mapped, rather than mapped for every write.
+	bool Persistent;
+
+	// Totals since the last resetCounters(): bytes written, the number of times the CPU had to wait for the GPU to release a region,
+	// the time spent waiting in milliseconds, and writes that didn't fit in the region (and were dropped).
+	long long BytesWritten;
+	int Stalls;
+	double StallTime;
+	int Overflows;
+
+	StreamBuffer() : Buffer(0), Target(GL_ARRAY_BUFFER), RegionSize(0), Persistent(false), BytesWritten(0), Stalls(0), StallTime(0.0),
+		Overflows(0), mapped(NULL), region(0), used(0), waited(false)
+	{
+		for (int i = 0; i < RegionCount; i++)
+			fences[i] = NULL;
+	}
+
+	// Create the buffer with room for regionSize bytes per frame. Persistent mapping is used when the driver supports it,
+	// unless allowPersistent is false.
+	bool create(GLenum target, GLsizeiptr regionSize, bool allowPersistent = true)
+	{
+		Target = target;
+		RegionSize = regionSize;
+		Persistent = allowPersistent && glExtensions().BufferStorage;
+
+		glGenBuffers(1, &Buffer);
+		renderState().bindBuffer(Target, Buffer);
+
+		GLsizeiptr size = RegionSize * RegionCount;
+		if (Persistent)
+		{
+			// Coherent mapping makes writes visible to the GPU without explicitly flushing them.
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glExtensions().BufferStorageData(Target, size, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(Target, 0, size, flags);
+			if (!mapped)
+			{
+				std::cout << "ERROR::STREAM_BUFFER::MAPPING_FAILED" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			glBufferData(Target, size, NULL, GL_STREAM_DRAW);
+		}
+
+		return true;
+	}
+
+	// Release the buffer and its fences. Must be called while the context is still current.
+	void destroy()
+	{
+		if (Buffer == 0)
+			return;
+
+		for (int i = 0; i < RegionCount; i++)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = NULL;
+		}
+
+		if (Persistent)
+		{
+			renderState().bindBuffer(Target, Buffer);
+			glUnmapBuffer(Target);
+		}
+		renderState().bindBuffer(Target, 0);
+		glDeleteBuffers(1, &Buffer);
+		Buffer = 0;
+		mapped = NULL;
+	}
+
+	// Reserve size bytes of this frame's region, aligned to alignment bytes, and map them for writing.
+	// Returns NULL if the region is full, or size is 0. offset receives the position of the data in the buffer, for glVertexAttribPointer
+	// or glBindBufferRange. The buffer is bound to its target afterwards, and unmap() has to be called once the data is written,
+	// before drawing with it.
+	void* map(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+	{
+		// There's nothing to write, and glMapBufferRange doesn't accept an empty range.
+		if (size <= 0)
+			return NULL;
+
+		GLsizeiptr start = (used + alignment - 1) / alignment * alignment;
+		if (start + size > RegionSize)
+		{
+			Overflows++;
+			return NULL;
+		}
+
+		// Wait for the GPU to finish reading this region, the first time it's written this time around.
+		if (!waited)
+		{
+			waitForRegion();
+			waited = true;
+		}
+
+		used = start + size;
+		offset = region * RegionSize + start;
+		BytesWritten += size;
+
+		renderState().bindBuffer(Target, Buffer);
+		if (Persistent)
+			return mapped + offset;
+
+		return glMapBufferRange(Target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	}
+
+	// Finish writing the range returned by the last map().
+	void unmap()
+	{
+		if (Persistent)
+			return;
+
+		renderState().bindBuffer(Target, Buffer);
+		glUnmapBuffer(Target);
+	}
+
+	// Copy size bytes into this frame's region. Returns the offset in the buffer, or -1 if the region is full or size is 0.
+	GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16)
+	{
+		GLintptr offset = 0;
+		void* destination = map(size, alignment, offset);
+		if (!destination)
+			return -1;
+
+		memcpy(destination, data, size);
+		unmap();
+		return offset;
+	}
+
+	// Call after the last draw reading this frame's data: fences the region and moves on to the next one.
+	void endFrame()
+	{
+		if (used > 0)
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		region = (region + 1) % RegionCount;
+		used = 0;
+		waited = false;
+	}
+
+	void resetCounters()
+	{
+		BytesWritten = 0;
+		Stalls = 0;
+		StallTime = 0.0;
+		Overflows = 0;
+	}
+
+private:
+	unsigned char* mapped;
+	GLsync fences[RegionCount];
+	int region;
+	GLsizeiptr used;
+	bool waited;
+
+	void waitForRegion()
+	{
+		GLsync fence = fences[region];
+		if (!fence)
+			return;
+
+		// Only count a stall if the fence isn't signaled yet. Waiting flushes the pending commands once, otherwise the fence might never be reached.
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do
+			{
+				result = glClientWaitSync(fence, flags, 1000000);
+				flags = 0;
+			} while (result == GL_TIMEOUT_EXPIRED);
+
+			Stalls++;
+			StallTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		glDeleteSync(fence);
+		fences[region] = NULL;
+	}
+};
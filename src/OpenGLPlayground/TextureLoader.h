@@ -0,0 +1,366 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "stb_image.h"
+
+#include "RenderState.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads textures in the background.
+// Decoding images with stb_image is by far the slowest part of loading a texture, and doesn't need OpenGL at all,
+// so it runs on a pool of worker threads. OpenGL calls are only allowed on the thread owning the context, so the workers hand
+// the decoded pixels back through a lock-free queue, and the render loop uploads them (through pixel buffer objects) when it calls update().
+// Until then, every texture is a 1x1 grey placeholder, so rendering can start right away.
+// An upload is spread over several frames, so the render thread never waits for a transfer to finish: update() copies the pixels into
+// one of a few pixel buffers and starts the transfer to the texture, and a later update() generates the mipmaps once a fence
+// shows the transfer is done, which also frees the pixel buffer for the next image.
+class TextureLoader
+{
+public:
+	// Number of textures that have been requested but aren't uploaded yet.
+	int Pending;
+
+	TextureLoader(int threadCount = 0) : Pending(0), completed(NULL), stopping(false), loadedCount(0)
+	{
+		for (int i = 0; i < UploadCount; i++)
+		{
+			uploads[i].Buffer = 0;
+			uploads[i].Size = 0;
+			uploads[i].Texture = 0;
+			uploads[i].Fence = NULL;
+		}
+
+		if (threadCount <= 0)
+		{
+			// Leave one core for the render thread.
+			threadCount = (int)std::thread::hardware_concurrency() - 1;
+			if (threadCount < 1)
+				threadCount = 1;
+		}
+
+		for (int i = 0; i < threadCount; i++)
+			workers.push_back(std::thread(&TextureLoader::workerMain, this));
+	}
+
+	~TextureLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+
+		// Free images that were decoded but never uploaded.
+		DecodedImage* image = completed.exchange(NULL);
+		while (image)
+		{
+			DecodedImage* next = image->Next;
+			stbi_image_free(image->Pixels);
+			delete image;
+			image = next;
+		}
+		for (size_t i = 0; i < waiting.size(); i++)
+		{
+			stbi_image_free(waiting[i]->Pixels);
+			delete waiting[i];
+		}
+	}
+
+	// Release the pixel buffers and the fences of the uploads in flight. Must be called while the context is still current.
+	void destroy()
+	{
+		for (int i = 0; i < UploadCount; i++)
+		{
+			if (uploads[i].Fence)
+				glDeleteSync(uploads[i].Fence);
+			if (uploads[i].Buffer)
+				glDeleteBuffers(1, &uploads[i].Buffer);
+			uploads[i].Buffer = 0;
+			uploads[i].Size = 0;
+			uploads[i].Fence = NULL;
+		}
+	}
+
+	// Create a texture showing a placeholder, and start decoding the image file in the background.
+	// The returned texture object stays the same once the image has been uploaded, so it can be bound right away.
+	unsigned int load(const char* path)
+	{
+		if (Pending == 0)
+			loadStart = std::chrono::steady_clock::now();
+
+		unsigned int texture;
+		glGenTextures(1, &texture);
+
+		// Bind the created texture to the GL_TEXTURE_2D target (of texture unit 0).
+		renderState().bindTexture(0, texture);
+
+		// Set the texture wrapping options (on the currently bound texture object).
+		// - 1st argument specifies the target, in this case, as we're working with a 2D texture, the target is GL_TEXTURE_2D.
+		// - 2nd argument specifies what option we want to set and for which texture axis (S/T is basically U/V)
+		// - 3rd argument specifies the wrapping mode
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		// Set the texture filtering method (on the currently bound texture object).
+		// - With GL_NEAREST, OpenGL selected the texture pixel (also known as a texel) that center us closest to on the texture coordinate.
+		// - With GL_LINEAR (also known as (bi)linear filtering), OpenGL takes an interpreted value from the texture coordinates neighboring texels,
+		//	 approximating a color between the texels.
+		// Texture filtering can be set individually for magnifying operations (when scaling up) or minifying operations (when scaling down).
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// A single grey texel is a complete texture (including its mipmap chain) to sample from until the real image arrives.
+		const unsigned char placeholder[] = { 128, 128, 128, 255 };
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			Job job = { texture, path };
+			jobs.push_back(job);
+		}
+		jobAvailable.notify_one();
+
+		Pending++;
+		return texture;
+	}
+
+	// Finish the uploads whose transfer is done, and start uploading the images that finished decoding since the last call.
+	// Must be called on the thread owning the OpenGL context. Returns the number of textures that were finished.
+	int update()
+	{
+		int finished = 0;
+		for (int i = 0; i < UploadCount; i++)
+		{
+			if (uploads[i].Fence && isSignaled(uploads[i].Fence))
+			{
+				finishUpload(uploads[i]);
+				finished++;
+				loaded();
+			}
+		}
+
+		// Take the whole list of decoded images at once. It's built by pushing to the front, so reverse it to upload in request order.
+		DecodedImage* image = completed.exchange(NULL, std::memory_order_acquire);
+		DecodedImage* ordered = NULL;
+		while (image)
+		{
+			DecodedImage* next = image->Next;
+			image->Next = ordered;
+			ordered = image;
+			image = next;
+		}
+
+		while (ordered)
+		{
+			DecodedImage* next = ordered->Next;
+			if (ordered->Pixels)
+			{
+				waiting.push_back(ordered);
+			}
+			else
+			{
+				// If we somehow failed to load the image, the placeholder stays.
+				std::cout << "Failed to load texture " << ordered->Path << std::endl;
+				delete ordered;
+				loaded();
+			}
+			ordered = next;
+		}
+
+		// Images that don't get a pixel buffer this frame wait for one of the uploads in flight to finish.
+		for (int i = 0; i < UploadCount && !waiting.empty(); i++)
+		{
+			if (uploads[i].Fence)
+				continue;
+
+			DecodedImage* decoded = waiting.front();
+			waiting.pop_front();
+			startUpload(uploads[i], *decoded);
+			stbi_image_free(decoded->Pixels);
+			delete decoded;
+		}
+
+		return finished;
+	}
+
+	// Block until every requested texture has been uploaded. Used when the output has to be deterministic, e.g. benchmarks.
+	void finish()
+	{
+		while (Pending > 0)
+		{
+			if (update() == 0)
+				std::this_thread::yield();
+		}
+	}
+
+private:
+	struct Job
+	{
+		unsigned int Texture;
+		std::string Path;
+	};
+
+	// A pixel buffer, and the upload from it in flight: the transfer into Texture is done once Fence is signaled.
+	// Buffers are kept and reused, only growing when an image doesn't fit.
+	struct Upload
+	{
+		unsigned int Buffer;
+		size_t Size;
+		unsigned int Texture;
+		GLsync Fence;
+	};
+
+	// A decoded image on its way from a worker thread to the render thread, linked into the completed list.
+	struct DecodedImage
+	{
+		unsigned int Texture;
+		std::string Path;
+		int Width, Height, Channels;
+		unsigned char* Pixels;
+		DecodedImage* Next;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Job> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobAvailable;
+
+	// Lock-free list of decoded images: any worker pushes to its head with a compare-and-swap,
+	// the render thread takes the entire list at once with an atomic exchange.
+	std::atomic<DecodedImage*> completed;
+
+	bool stopping;
+	int loadedCount;
+	std::chrono::steady_clock::time_point loadStart;
+
+	// Decoded images waiting for a free pixel buffer, in request order. Only used by the render thread.
+	std::deque<DecodedImage*> waiting;
+
+	static const int UploadCount = 4;
+	Upload uploads[UploadCount];
+
+	void workerMain()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(jobMutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				job = jobs.front();
+				jobs.pop_front();
+			}
+
+			// The function stbi_load (from stb_image.h library) takes an image and provides us with the width, height and number of color channels.
+			DecodedImage* image = new DecodedImage();
+			image->Texture = job.Texture;
+			image->Path = job.Path;
+			image->Pixels = stbi_load(job.Path.c_str(), &image->Width, &image->Height, &image->Channels, 0);
+
+			image->Next = completed.load(std::memory_order_relaxed);
+			while (!completed.compare_exchange_weak(image->Next, image, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+		}
+	}
+
+	// Count a texture as done, and report the load time once all of them are.
+	void loaded()
+	{
+		Pending--;
+		loadedCount++;
+		if (Pending == 0)
+		{
+			std::cout << "Loaded " << loadedCount << " textures in "
+				<< std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms ("
+				<< workers.size() << " decode threads)" << std::endl;
+			loadedCount = 0;
+		}
+	}
+
+	// Whether the GPU is past the fence, without waiting. Flushes the pending commands, otherwise the fence might never be reached.
+	static bool isSignaled(GLsync fence)
+	{
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED;
+	}
+
+	// Start uploading a decoded image into its texture through a free pixel buffer object (PBO).
+	// With a PBO bound to GL_PIXEL_UNPACK_BUFFER, glTexImage2D reads from the buffer instead of client memory, so it returns right
+	// away and the driver transfers the pixels later. The mipmaps are built from the transferred image, so they're left for
+	// finishUpload(): generating them right here would make the driver finish the transfer first, blocking the render thread.
+	void startUpload(Upload& upload, const DecodedImage& image)
+	{
+		// Pick the matching format: jpg files usually have RGB values, while png files (such as awesomeface.png) also have an alpha channel.
+		GLenum format = image.Channels == 4 ? GL_RGBA : image.Channels == 3 ? GL_RGB : image.Channels == 2 ? GL_RG : GL_RED;
+		size_t size = (size_t)image.Width * image.Height * image.Channels;
+
+		if (!upload.Buffer)
+			glGenBuffers(1, &upload.Buffer);
+		renderState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.Buffer);
+		if (upload.Size < size)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+			upload.Size = size;
+		}
+
+		// The fence of the buffer's last upload has signaled, so nothing reads it anymore and there's nothing to synchronize with.
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mapped)
+		{
+			memcpy(mapped, image.Pixels, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else
+		{
+			// Fall back to uploading straight from client memory, which requires the PBO to be unbound.
+			renderState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		// Rows of RGB images aren't necessarily a multiple of 4 bytes long, the default unpack alignment.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		// Once the texture has been created and bound, we can generate a texture with the loaded image data using glTexImage2D.
+		// - 1st argument specifies the texture target, generating a texture on the currently bound texture object on the target.
+		// - 2nd argument specifies the mipmap level for which we want to create a texture for.
+		// - 3rd argument specifies what kind of format we want to store the texture in, in OpenGL.
+		// - 4th and 5th arguments specifies the width and the height of the image.
+		// - 6th argument should always be hardcoded as 0 (legacy stuff).
+		// - 7th and 8th arguments specifies the format and the data type of the source image.
+		// - 9th argument is the image data, which is an offset into the bound PBO (0) instead of a pointer, or the client memory if mapping failed.
+		// Until its mipmaps exist, the texture is limited to level 0, so it stays complete and can be sampled in the meantime.
+		renderState().bindTexture(0, image.Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, mapped ? 0 : image.Pixels);
+
+		renderState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		upload.Texture = image.Texture;
+		upload.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// The transfer is done: build the mipmaps from the uploaded image, and hand the pixel buffer to the next image.
+	void finishUpload(Upload& upload)
+	{
+		renderState().bindTexture(0, upload.Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		glDeleteSync(upload.Fence);
+		upload.Fence = NULL;
+	}
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Like the frustum culler, the SIMD paths build on GLM's SSE kernels (glm/simd), and process 8 objects per iteration when AVX is enabled.
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <glm/simd/common.h>
+#include <glm/simd/matrix.h>
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+#include <immintrin.h>
+#endif
+
+// The position, rotation and scale of a list of objects, composed into their model matrices.
+// Every component is stored in its own array (structure of arrays), so the translation, rotation and scale of 4 (SSE) or 8 (AVX)
+// consecutive objects are loaded with a single instruction per component, and their matrices are built side by side: each register
+// holds the same matrix element of several objects. The rotations are unit quaternions, which turn into a rotation matrix with a
+// few multiplies and adds, instead of the sine and cosine glm::rotate computes from an angle and axis.
+// Every object has a dirty bit, set whenever its transform changes. update() only rebuilds the matrices of dirty objects, and skips
+// 32 clean objects at a time, so a scene that mostly stands still costs next to nothing.
+class TransformSystem
+{
+public:
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	// The model matrix of every object, as of the last update().
+	std::vector<glm::mat4> Matrices;
+
+	// Number of matrices rebuilt by the last update() call.
+	size_t Updated;
+
+	TransformSystem() : Updated(0)
+	{
+	}
+
+	size_t size() const
+	{
+		return PositionX.size();
+	}
+
+	void reserve(size_t count)
+	{
+		PositionX.reserve(count);
+		PositionY.reserve(count);
+		PositionZ.reserve(count);
+		RotationX.reserve(count);
+		RotationY.reserve(count);
+		RotationZ.reserve(count);
+		RotationW.reserve(count);
+		ScaleX.reserve(count);
+		ScaleY.reserve(count);
+		ScaleZ.reserve(count);
+		Matrices.reserve(count);
+		dirty.reserve((count + 31) / 32);
+	}
+
+	// Add an object, returning its index. Its matrix is built by the next update().
+	unsigned int add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f))
+	{
+		unsigned int index = (unsigned int)size();
+		PositionX.push_back(position.x);
+		PositionY.push_back(position.y);
+		PositionZ.push_back(position.z);
+		RotationX.push_back(rotation.x);
+		RotationY.push_back(rotation.y);
+		RotationZ.push_back(rotation.z);
+		RotationW.push_back(rotation.w);
+		ScaleX.push_back(scale.x);
+		ScaleY.push_back(scale.y);
+		ScaleZ.push_back(scale.z);
+		Matrices.push_back(glm::mat4(1.0f));
+		if (index % 32 == 0)
+			dirty.push_back(0);
+		markDirty(index);
+		return index;
+	}
+
+	void setPosition(unsigned int index, const glm::vec3& position)
+	{
+		PositionX[index] = position.x;
+		PositionY[index] = position.y;
+		PositionZ[index] = position.z;
+		markDirty(index);
+	}
+
+	void setRotation(unsigned int index, const glm::quat& rotation)
+	{
+		RotationX[index] = rotation.x;
+		RotationY[index] = rotation.y;
+		RotationZ[index] = rotation.z;
+		RotationW[index] = rotation.w;
+		markDirty(index);
+	}
+
+	void setScale(unsigned int index, const glm::vec3& scale)
+	{
+		ScaleX[index] = scale.x;
+		ScaleY[index] = scale.y;
+		ScaleZ[index] = scale.z;
+		markDirty(index);
+	}
+
+	// Objects whose components were written directly have to be marked dirty by hand.
+	void markDirty(unsigned int index)
+	{
+		dirty[index / 32] |= 1u << (index % 32);
+	}
+
+	bool isDirty(unsigned int index) const
+	{
+		return (dirty[index / 32] >> (index % 32)) & 1u;
+	}
+
+	// Rebuild the matrices of the dirty objects, and mark them clean.
+	void update()
+	{
+		compose();
+		clearDirty();
+	}
+
+	// Rebuild the matrices of the dirty objects using the widest instruction set available, but leave them marked dirty, so the
+	// caller can still tell which matrices changed (see SceneGraph.h). clearDirty() has to follow.
+	// A SIMD group with any dirty object is rebuilt as a whole: the clean objects in it get the matrix they already had.
+	void compose()
+	{
+		Updated = 0;
+		size_t i = 0;
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		composeAVX(i);
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		composeSSE(i);
+#endif
+
+		// Whatever doesn't fill a whole SIMD register is composed one by one.
+		composeScalar(i);
+	}
+
+	void clearDirty()
+	{
+		std::fill(dirty.begin(), dirty.end(), 0u);
+	}
+
+	// Reference implementation building the dirty matrices one at a time with glm, used to verify and benchmark the SIMD paths.
+	void updateReference()
+	{
+		Updated = 0;
+		for (unsigned int i = 0; i < size(); i++)
+		{
+			if (!isDirty(i))
+				continue;
+
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(PositionX[i], PositionY[i], PositionZ[i]));
+			model = model * glm::mat4_cast(glm::quat(RotationW[i], RotationX[i], RotationY[i], RotationZ[i]));
+			model = glm::scale(model, glm::vec3(ScaleX[i], ScaleY[i], ScaleZ[i]));
+			Matrices[i] = model;
+			Updated++;
+		}
+
+		clearDirty();
+	}
+
+private:
+	// One bit per object, 32 objects per word.
+	std::vector<uint32_t> dirty;
+
+	// Compose the dirty objects in [first, size) one at a time.
+	// Uses the same formulas as the SIMD paths: the rotation matrix of the quaternion (as glm::mat3_cast builds it), its columns
+	// multiplied by the scale, and the position as the last column.
+	void composeScalar(size_t& first)
+	{
+		for (size_t i = first; i < size(); i++)
+		{
+			if (!isDirty((unsigned int)i))
+				continue;
+
+			float x = RotationX[i], y = RotationY[i], z = RotationZ[i], w = RotationW[i];
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, xz = x * z, yz = y * z;
+			float wx = w * x, wy = w * y, wz = w * z;
+
+			glm::mat4& model = Matrices[i];
+			model[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * ScaleX[i];
+			model[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * ScaleY[i];
+			model[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * ScaleZ[i];
+			model[3] = glm::vec4(PositionX[i], PositionY[i], PositionZ[i], 1.0f);
+			Updated++;
+		}
+		first = size();
+	}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	// Write the matrices of 4 objects. columns[c][r] holds element [c][r] of all 4 matrices, so transposing the rows of a column
+	// gives that column of each matrix.
+	static void storeSSE(glm::mat4* matrices, const glm_vec4 columns[4][4])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			glm_vec4 column[4];
+			glm_mat4_transpose(columns[c], column);
+			for (int k = 0; k < 4; k++)
+				_mm_storeu_ps(&matrices[k][c][0], column[k]);
+		}
+	}
+
+	// Compose 4 objects per iteration. Advances first past the last whole group of 4.
+	void composeSSE(size_t& first)
+	{
+		const glm_vec4 zero = _mm_setzero_ps();
+		const glm_vec4 one = _mm_set1_ps(1.0f);
+		const glm_vec4 two = _mm_set1_ps(2.0f);
+		const size_t end = size() & ~(size_t)3;
+		for (size_t i = 0; i < end; i += 4)
+		{
+			// Skip a whole word of clean objects at once (the loop adds the last 4).
+			if (i % 32 == 0 && dirty[i / 32] == 0)
+			{
+				i += 28;
+				continue;
+			}
+			if (((dirty[i / 32] >> (i % 32)) & 0xFu) == 0)
+				continue;
+
+			glm_vec4 x = _mm_loadu_ps(&RotationX[i]);
+			glm_vec4 y = _mm_loadu_ps(&RotationY[i]);
+			glm_vec4 z = _mm_loadu_ps(&RotationZ[i]);
+			glm_vec4 w = _mm_loadu_ps(&RotationW[i]);
+			glm_vec4 sx = _mm_loadu_ps(&ScaleX[i]);
+			glm_vec4 sy = _mm_loadu_ps(&ScaleY[i]);
+			glm_vec4 sz = _mm_loadu_ps(&ScaleZ[i]);
+
+			glm_vec4 xx = glm_vec4_mul(x, x), yy = glm_vec4_mul(y, y), zz = glm_vec4_mul(z, z);
+			glm_vec4 xy = glm_vec4_mul(x, y), xz = glm_vec4_mul(x, z), yz = glm_vec4_mul(y, z);
+			glm_vec4 wx = glm_vec4_mul(w, x), wy = glm_vec4_mul(w, y), wz = glm_vec4_mul(w, z);
+
+			glm_vec4 columns[4][4];
+			columns[0][0] = glm_vec4_mul(glm_vec4_sub(one, glm_vec4_mul(two, glm_vec4_add(yy, zz))), sx);
+			columns[0][1] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_add(xy, wz)), sx);
+			columns[0][2] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_sub(xz, wy)), sx);
+			columns[0][3] = zero;
+			columns[1][0] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_sub(xy, wz)), sy);
+			columns[1][1] = glm_vec4_mul(glm_vec4_sub(one, glm_vec4_mul(two, glm_vec4_add(xx, zz))), sy);
+			columns[1][2] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_add(yz, wx)), sy);
+			columns[1][3] = zero;
+			columns[2][0] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_add(xz, wy)), sz);
+			columns[2][1] = glm_vec4_mul(glm_vec4_mul(two, glm_vec4_sub(yz, wx)), sz);
+			columns[2][2] = glm_vec4_mul(glm_vec4_sub(one, glm_vec4_mul(two, glm_vec4_add(xx, yy))), sz);
+			columns[2][3] = zero;
+			columns[3][0] = _mm_loadu_ps(&PositionX[i]);
+			columns[3][1] = _mm_loadu_ps(&PositionY[i]);
+			columns[3][2] = _mm_loadu_ps(&PositionZ[i]);
+			columns[3][3] = one;
+
+			storeSSE(&Matrices[i], columns);
+			Updated += 4;
+		}
+
+		first = end;
+	}
+#endif
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+	// Compose 8 objects per iteration. Advances first past the last whole group of 8.
+	// The matrices are built 8 wide, and written out as two groups of 4, since transposing stays within 128-bit lanes anyway.
+	void composeAVX(size_t& first)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const size_t end = size() & ~(size_t)7;
+		for (size_t i = 0; i < end; i += 8)
+		{
+			// Skip a whole word of clean objects at once (the loop adds the last 8).
+			if (i % 32 == 0 && dirty[i / 32] == 0)
+			{
+				i += 24;
+				continue;
+			}
+			if (((dirty[i / 32] >> (i % 32)) & 0xFFu) == 0)
+				continue;
+
+			__m256 x = _mm256_loadu_ps(&RotationX[i]);
+			__m256 y = _mm256_loadu_ps(&RotationY[i]);
+			__m256 z = _mm256_loadu_ps(&RotationZ[i]);
+			__m256 w = _mm256_loadu_ps(&RotationW[i]);
+			__m256 sx = _mm256_loadu_ps(&ScaleX[i]);
+			__m256 sy = _mm256_loadu_ps(&ScaleY[i]);
+			__m256 sz = _mm256_loadu_ps(&ScaleZ[i]);
+
+			__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+			__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+			__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+			__m256 columns[4][4];
+			columns[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+			columns[0][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+			columns[0][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+			columns[0][3] = zero;
+			columns[1][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+			columns[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+			columns[1][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+			columns[1][3] = zero;
+			columns[2][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+			columns[2][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+			columns[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+			columns[2][3] = zero;
+			columns[3][0] = _mm256_loadu_ps(&PositionX[i]);
+			columns[3][1] = _mm256_loadu_ps(&PositionY[i]);
+			columns[3][2] = _mm256_loadu_ps(&PositionZ[i]);
+			columns[3][3] = one;
+
+			glm_vec4 low[4][4], high[4][4];
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					low[c][r] = _mm256_castps256_ps128(columns[c][r]);
+					high[c][r] = _mm256_extractf128_ps(columns[c][r], 1);
+				}
+			}
+			storeSSE(&Matrices[i], low);
+			storeSSE(&Matrices[i + 4], high);
+			Updated += 8;
+		}
+
+		first = end;
+	}
+#endif
+};
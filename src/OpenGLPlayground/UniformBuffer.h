@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "RenderState.h"
+
+#include <cstring>
+
+// Uniform blocks and the binding points their buffers are bound to.
+// Every program using a block reads it from the same binding point, so a uniform buffer object (UBO) is written once
+// and bound once, instead of setting the same uniforms on every program with glUniform*. Shader looks up the binding point
+// of every uniform block in its program right after linking, so shaders don't need layout (binding = N) (which requires GLSL 4.20).
+enum UniformBlockBinding
+{
+	FrameBlockBinding = 0
+};
+
+// Binding point of a uniform block by its name in GLSL, or -1 for an unknown block.
+inline int uniformBlockBinding(const char* name)
+{
+	if (strcmp(name, "Frame") == 0)
+		return FrameBlockBinding;
+	return -1;
+}
+
+// Per-frame data shared by all shaders, mirroring the std140 layout of the Frame uniform block:
+//
+//	layout (std140) uniform Frame
+//	{
+//		mat4 view;
+//		mat4 projection;
+//		mat4 viewProjection;
+//		vec3 cameraPosition;
+//		float time;
+//	};
+//
+// In std140 a vec3 is aligned to 16 bytes like a vec4, but the float following it fills its 4th component,
+// so the C++ struct has exactly the same layout without any padding.
+struct FrameUniforms
+{
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::mat4 ViewProjection;
+	glm::vec3 CameraPosition;
+	float Time;
+};
+static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms must match the std140 layout of the Frame uniform block");
+
+// A uniform buffer object holding one T, bound to a fixed binding point for its whole lifetime.
+template <typename T>
+class UniformBuffer
+{
+public:
+	unsigned int UBO;
+	unsigned int Binding;
+
+	UniformBuffer() : UBO(0), Binding(0)
+	{
+	}
+
+	// Create the buffer and bind it to the binding point. Every program reading the block then sees its contents.
+	void create(unsigned int binding)
+	{
+		Binding = binding;
+		glGenBuffers(1, &UBO);
+		renderState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_STREAM_DRAW);
+		renderState().bindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+	}
+
+	// Write the contents for this frame. Orphaning the storage first means we don't have to wait for the previous frame's draws to finish reading it.
+	void update(const T& value)
+	{
+		renderState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+	}
+};
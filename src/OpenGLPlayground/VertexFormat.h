@@ -0,0 +1,450 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "MeshBuilder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// How one vertex attribute is stored in a vertex buffer: exactly the arguments of glVertexAttribPointer.
+struct MeshAttribute
+{
+	uint32_t Location;
+	uint32_t Components;
+	uint32_t Type;
+	uint32_t Normalized;
+	uint32_t Offset;
+	uint32_t Reserved;
+};
+
+// Point the vertex attributes of the bound vertex array at the vertex buffer bound to GL_ARRAY_BUFFER.
+inline void setVertexAttributes(const MeshAttribute* attributes, size_t count, GLsizei stride)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const MeshAttribute& attribute = attributes[i];
+		glVertexAttribPointer(attribute.Location, (GLint)attribute.Components, attribute.Type, attribute.Normalized ? GL_TRUE : GL_FALSE,
+			stride, (void*)(uintptr_t)attribute.Offset);
+		glEnableVertexAttribArray(attribute.Location);
+	}
+}
+
+// How an attribute's floats are stored in the vertex buffer.
+//	- FloatEncoding: 32-bit floats, exact.
+//	- HalfEncoding: 16-bit floats (GL_HALF_FLOAT), 11 bits of precision relative to the value, values in [-65504, 65504].
+//	- Snorm16Encoding: 16-bit signed normalized integers (GL_SHORT), values in [-1, 1] with a fixed step of 1/32767.
+//	- Unorm16Encoding: 16-bit unsigned normalized integers (GL_UNSIGNED_SHORT), values in [0, 1] with a fixed step of 1/65535.
+//	- Packed1010102Encoding: 3 signed normalized 10-bit values and a 2-bit w in 32 bits (GL_INT_2_10_10_10_REV), values in [-1, 1].
+//	- OctahedralEncoding: a unit vector folded onto an octahedron and stored as 2 snorm16 values. Only the 2 octahedron coordinates reach
+//		the vertex shader, which has to unfold them itself:
+//			vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//			if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+//			n = normalize(n);
+// The normalized integers are converted back to floats by the vertex fetch, so the vertex shader sees the same values either way.
+// (Up to OpenGL 4.1 signed normalized values may be converted as (2c + 1) / (2^b - 1) rather than c / (2^(b-1) - 1), which differs by
+// less than one step.)
+enum AttributeEncoding
+{
+	FloatEncoding,
+	HalfEncoding,
+	Snorm16Encoding,
+	Unorm16Encoding,
+	Packed1010102Encoding,
+	OctahedralEncoding
+};
+
+// Vertices compiled into a vertex format: the bytes to upload and the attribute layout to draw them with.
+struct PackedVertices
+{
+	std::vector<unsigned char> Data;
+	uint32_t Stride;
+	size_t VertexCount;
+	std::vector<MeshAttribute> Attributes;
+
+	PackedVertices() : Stride(0), VertexCount(0)
+	{
+	}
+
+	void setAttributePointers() const
+	{
+		setVertexAttributes(Attributes.data(), Attributes.size(), (GLsizei)Stride);
+	}
+};
+
+// Compiles the playground's float vertices (position, texture coordinates and optionally a normal: 5 or 8 floats per vertex)
+// into a smaller vertex format.
+// Every float vertex costs 20 (or 32) bytes of memory and bandwidth, while positions of a model, texture coordinates and normals need
+// far less than 32 bits of precision per component. Stored as half floats or 16-bit normalized integers, and normals as 10:10:10:2
+// or octahedral, a vertex takes 12 (or 16) bytes, and the vertex fetch converts them back to floats for free.
+// Every attribute is padded to a multiple of 4 bytes, as most hardware fetches unaligned attributes slowly.
+// compile() also decodes the packed vertices again and reports the error against the float vertices, so a format can be judged before it's used.
+class VertexFormat
+{
+public:
+	// Vertex attribute locations of the attributes. Locations 2 to 5 hold the instanced model matrix.
+	static const unsigned int PositionAttribute = 0;
+	static const unsigned int TexCoordAttribute = 1;
+	static const unsigned int NormalAttribute = 6;
+
+	AttributeEncoding Position;
+	AttributeEncoding TexCoord;
+	AttributeEncoding Normal;
+
+	VertexFormat() : Position(FloatEncoding), TexCoord(FloatEncoding), Normal(FloatEncoding)
+	{
+	}
+
+	// Parse a format: "float", "packed" (snorm16 positions, unorm16 texture coordinates, octahedral normals), or a list of
+	// attribute=encoding pairs, e.g. "position=half,texcoord=unorm16,normal=10_10_10_2". Attributes not listed stay floats.
+	static bool parse(const std::string& spec, VertexFormat& format)
+	{
+		format = VertexFormat();
+		if (spec == "float")
+			return true;
+		if (spec == "packed")
+		{
+			format.Position = Snorm16Encoding;
+			format.TexCoord = Unorm16Encoding;
+			format.Normal = OctahedralEncoding;
+			return true;
+		}
+
+		size_t start = 0;
+		while (start <= spec.size())
+		{
+			size_t end = spec.find(',', start);
+			if (end == std::string::npos)
+				end = spec.size();
+			std::string pair = spec.substr(start, end - start);
+			size_t equals = pair.find('=');
+			if (equals == std::string::npos)
+				return false;
+
+			std::string attribute = pair.substr(0, equals);
+			AttributeEncoding encoding;
+			if (!parseEncoding(pair.substr(equals + 1), encoding))
+				return false;
+			if (attribute == "position")
+				format.Position = encoding;
+			else if (attribute == "texcoord")
+				format.TexCoord = encoding;
+			else if (attribute == "normal")
+				format.Normal = encoding;
+			else
+				return false;
+			start = end + 1;
+		}
+		return true;
+	}
+
+	static const char* name(AttributeEncoding encoding)
+	{
+		switch (encoding)
+		{
+		case HalfEncoding: return "half";
+		case Snorm16Encoding: return "snorm16";
+		case Unorm16Encoding: return "unorm16";
+		case Packed1010102Encoding: return "10_10_10_2";
+		case OctahedralEncoding: return "octahedral";
+		default: return "float";
+		}
+	}
+
+	// Compile the vertices of a mesh, and write the error report to report (if not NULL).
+	// Fails if an attribute doesn't fit its encoding, e.g. positions outside [-1, 1] as snorm16 (use half floats for those).
+	bool compile(const IndexedMesh& mesh, PackedVertices& packed, std::ostream* report) const
+	{
+		if (mesh.Stride != 5 && mesh.Stride != 8)
+		{
+			std::cout << "ERROR::VERTEX_FORMAT::UNSUPPORTED_LAYOUT " << mesh.Stride << " floats per vertex" << std::endl;
+			return false;
+		}
+
+		Source sources[3] = {
+			{ "position", PositionAttribute, Position, 0, 3 },
+			{ "texcoord", TexCoordAttribute, TexCoord, 3, 2 },
+			{ "normal", NormalAttribute, Normal, 5, 3 }
+		};
+		const int sourceCount = mesh.Stride == 8 ? 3 : 2;
+
+		packed = PackedVertices();
+		packed.VertexCount = mesh.vertexCount();
+		for (int i = 0; i < sourceCount; i++)
+		{
+			if (!layout(sources[i], packed))
+				return false;
+		}
+
+		packed.Data.assign(packed.VertexCount * packed.Stride, 0);
+		for (int i = 0; i < sourceCount; i++)
+		{
+			Source& source = sources[i];
+			const MeshAttribute& attribute = packed.Attributes[i];
+			for (size_t vertex = 0; vertex < packed.VertexCount; vertex++)
+			{
+				const float* value = &mesh.Vertices[vertex * mesh.Stride + source.First];
+				unsigned char* destination = &packed.Data[vertex * packed.Stride + attribute.Offset];
+				if (!inRange(source.Encoding, value, source.Components))
+				{
+					std::cout << "ERROR::VERTEX_FORMAT::OUT_OF_RANGE " << source.Name << " of vertex " << vertex << " doesn't fit "
+						<< name(source.Encoding) << std::endl;
+					return false;
+				}
+
+				encode(source.Encoding, value, source.Components, destination);
+
+				// Decode the attribute again, the way the vertex fetch (and the shader, for octahedral normals) will, and measure the error.
+				float decoded[3];
+				decode(source.Encoding, destination, source.Components, decoded);
+				double squared = 0.0;
+				for (int c = 0; c < source.Components; c++)
+				{
+					double error = fabs((double)decoded[c] - value[c]);
+					source.MaxError = error > source.MaxError ? error : source.MaxError;
+					squared += error * error;
+				}
+				source.SquaredError += squared;
+				if (source.Location == NormalAttribute)
+				{
+					glm::vec3 original(value[0], value[1], value[2]);
+					glm::vec3 result(decoded[0], decoded[1], decoded[2]);
+					float lengths = glm::length(original) * glm::length(result);
+					if (lengths > 0.0f)
+					{
+						double angle = glm::degrees(acos(glm::clamp(glm::dot(original, result) / lengths, -1.0f, 1.0f)));
+						source.MaxAngle = angle > source.MaxAngle ? angle : source.MaxAngle;
+					}
+				}
+			}
+		}
+
+		if (report)
+		{
+			*report << "Vertex format: " << mesh.Stride * sizeof(float) << " -> " << packed.Stride << " bytes per vertex ("
+				<< (float)(mesh.Stride * sizeof(float)) / packed.Stride << "x smaller)" << std::endl;
+			for (int i = 0; i < sourceCount; i++)
+			{
+				const Source& source = sources[i];
+				*report << "  " << source.Name << ": " << name(source.Encoding) << ", " << source.Components * sizeof(float) << " -> "
+					<< source.Size << " bytes, max error " << source.MaxError << ", rms error "
+					<< (packed.VertexCount ? sqrt(source.SquaredError / (packed.VertexCount * source.Components)) : 0.0);
+				if (source.Location == NormalAttribute)
+					*report << ", max angle " << source.MaxAngle << " degrees";
+				*report << std::endl;
+			}
+		}
+		return true;
+	}
+
+private:
+	// One attribute of the float vertices, and the error statistics of its encoding.
+	struct Source
+	{
+		const char* Name;
+		unsigned int Location;
+		AttributeEncoding Encoding;
+		int First;
+		int Components;
+		int Size;
+		double MaxError;
+		double SquaredError;
+		double MaxAngle;
+
+		Source(const char* name, unsigned int location, AttributeEncoding encoding, int first, int components)
+			: Name(name), Location(location), Encoding(encoding), First(first), Components(components), Size(0), MaxError(0.0), SquaredError(0.0), MaxAngle(0.0)
+		{
+		}
+	};
+
+	static bool parseEncoding(const std::string& text, AttributeEncoding& encoding)
+	{
+		const AttributeEncoding encodings[] = { FloatEncoding, HalfEncoding, Snorm16Encoding, Unorm16Encoding, Packed1010102Encoding, OctahedralEncoding };
+		for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++)
+		{
+			if (text == name(encodings[i]))
+			{
+				encoding = encodings[i];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Append an attribute to the packed layout, generating its glVertexAttribPointer arguments.
+	static bool layout(Source& source, PackedVertices& packed)
+	{
+		MeshAttribute attribute = { source.Location, (uint32_t)source.Components, GL_FLOAT, GL_FALSE, packed.Stride, 0 };
+		switch (source.Encoding)
+		{
+		case FloatEncoding:
+			source.Size = source.Components * 4;
+			break;
+		case HalfEncoding:
+			attribute.Type = GL_HALF_FLOAT;
+			source.Size = (source.Components * 2 + 3) & ~3;
+			break;
+		case Snorm16Encoding:
+			attribute.Type = GL_SHORT;
+			attribute.Normalized = GL_TRUE;
+			source.Size = (source.Components * 2 + 3) & ~3;
+			break;
+		case Unorm16Encoding:
+			attribute.Type = GL_UNSIGNED_SHORT;
+			attribute.Normalized = GL_TRUE;
+			source.Size = (source.Components * 2 + 3) & ~3;
+			break;
+		case Packed1010102Encoding:
+			// Packed types always have 4 components, the shader ignores w when the input is a vec3.
+			if (source.Components != 3)
+			{
+				std::cout << "ERROR::VERTEX_FORMAT::UNSUPPORTED_ENCODING " << name(source.Encoding) << " for " << source.Name << std::endl;
+				return false;
+			}
+			attribute.Type = GL_INT_2_10_10_10_REV;
+			attribute.Normalized = GL_TRUE;
+			attribute.Components = 4;
+			source.Size = 4;
+			break;
+		case OctahedralEncoding:
+			if (source.Location != NormalAttribute)
+			{
+				std::cout << "ERROR::VERTEX_FORMAT::UNSUPPORTED_ENCODING " << name(source.Encoding) << " for " << source.Name << std::endl;
+				return false;
+			}
+			attribute.Type = GL_SHORT;
+			attribute.Normalized = GL_TRUE;
+			attribute.Components = 2;
+			source.Size = 4;
+			break;
+		}
+
+		packed.Attributes.push_back(attribute);
+		packed.Stride += source.Size;
+		return true;
+	}
+
+	static bool inRange(AttributeEncoding encoding, const float* value, int components)
+	{
+		float low = -1.0f, high = 1.0f;
+		if (encoding == FloatEncoding || encoding == OctahedralEncoding)
+			return true;
+		if (encoding == Unorm16Encoding)
+			low = 0.0f;
+
+		// Past the largest finite half float, values would turn into infinity.
+		if (encoding == HalfEncoding)
+		{
+			low = -65504.0f;
+			high = 65504.0f;
+		}
+
+		for (int c = 0; c < components; c++)
+		{
+			if (!(value[c] >= low && value[c] <= high))
+				return false;
+		}
+		return true;
+	}
+
+	static void encode(AttributeEncoding encoding, const float* value, int components, unsigned char* destination)
+	{
+		uint16_t* shorts = (uint16_t*)destination;
+		switch (encoding)
+		{
+		case FloatEncoding:
+			memcpy(destination, value, components * sizeof(float));
+			break;
+		case HalfEncoding:
+			for (int c = 0; c < components; c++)
+				shorts[c] = glm::packHalf1x16(value[c]);
+			break;
+		case Snorm16Encoding:
+			for (int c = 0; c < components; c++)
+				shorts[c] = glm::packSnorm1x16(value[c]);
+			break;
+		case Unorm16Encoding:
+			for (int c = 0; c < components; c++)
+				shorts[c] = glm::packUnorm1x16(value[c]);
+			break;
+		case Packed1010102Encoding:
+		{
+			glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(value[0], value[1], value[2], 0.0f));
+			memcpy(destination, &packed, sizeof(packed));
+			break;
+		}
+		case OctahedralEncoding:
+		{
+			// Project the unit vector onto the octahedron |x| + |y| + |z| = 1, and fold the lower half over the upper half.
+			glm::vec3 normal(value[0], value[1], value[2]);
+			float sum = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+			glm::vec2 folded = sum > 0.0f ? glm::vec2(normal.x, normal.y) / sum : glm::vec2(0.0f);
+			if (normal.z < 0.0f)
+				folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * signNotZero(folded);
+			shorts[0] = glm::packSnorm1x16(folded.x);
+			shorts[1] = glm::packSnorm1x16(folded.y);
+			break;
+		}
+		}
+	}
+
+	static void decode(AttributeEncoding encoding, const unsigned char* source, int components, float* value)
+	{
+		const uint16_t* shorts = (const uint16_t*)source;
+		switch (encoding)
+		{
+		case FloatEncoding:
+			memcpy(value, source, components * sizeof(float));
+			break;
+		case HalfEncoding:
+			for (int c = 0; c < components; c++)
+				value[c] = glm::unpackHalf1x16(shorts[c]);
+			break;
+		case Snorm16Encoding:
+			for (int c = 0; c < components; c++)
+				value[c] = glm::unpackSnorm1x16(shorts[c]);
+			break;
+		case Unorm16Encoding:
+			for (int c = 0; c < components; c++)
+				value[c] = glm::unpackUnorm1x16(shorts[c]);
+			break;
+		case Packed1010102Encoding:
+		{
+			glm::uint32 packed;
+			memcpy(&packed, source, sizeof(packed));
+			glm::vec4 unpacked = glm::unpackSnorm3x10_1x2(packed);
+			value[0] = unpacked.x;
+			value[1] = unpacked.y;
+			value[2] = unpacked.z;
+			break;
+		}
+		case OctahedralEncoding:
+		{
+			glm::vec2 folded(glm::unpackSnorm1x16(shorts[0]), glm::unpackSnorm1x16(shorts[1]));
+			glm::vec3 normal(folded.x, folded.y, 1.0f - fabs(folded.x) - fabs(folded.y));
+			if (normal.z < 0.0f)
+			{
+				glm::vec2 unfolded = (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) * signNotZero(glm::vec2(normal.x, normal.y));
+				normal.x = unfolded.x;
+				normal.y = unfolded.y;
+			}
+			normal = glm::normalize(normal);
+			value[0] = normal.x;
+			value[1] = normal.y;
+			value[2] = normal.z;
+			break;
+		}
+		}
+	}
+
+	static glm::vec2 signNotZero(const glm::vec2& v)
+	{
+		return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+	}
+};
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in mat4 aModel;
+
+out vec2 TexCoord;
+
+// Per-frame data shared by all shaders, written once per frame (see UniformBuffer.h).
+layout (std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec3 cameraPosition;
+	float time;
+};
+
+void main()
+{
+	gl_Position = viewProjection * aModel * vec4(aPos, 1.0f);
+	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+}
\ No newline at end of file
@@ -1,18 +1,51 @@
-#include <glad\glad.h>
-#include <GLFW\glfw3.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
 #include "stb_image.h"
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
-
+#include "ShaderCache.h"
+#include "ShaderLibrary.h"
+#include "ShaderWatcher.h"
+#include "SoftwareRasterizer.h"
+#include "GLExtensions.h"
+#include "GoldenImages.h"
+#include "HeadlessContext.h"
+#include "Image.h"
+#include "Benchmark.h"
+#include "FrustumCuller.h"
+#include "GpuProfiler.h"
+#include "InstancedRenderer.h"
+#include "MeshBuilder.h"
+#include "MeshConverter.h"
+#include "MeshFile.h"
+#include "FramePipeline.h"
+#include "ProfilerOverlay.h"
+#include "RenderState.h"
+#include "Microbenchmarks.h"
+#include "RenderQueue.h"
+#include "TextureLoader.h"
+#include "TransformSystem.h"
+#include "UniformBuffer.h"
+#include "VertexFormat.h"
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void generateCubePositions(std::vector<glm::vec3>& positions, int count);
+void addCubeTransforms(TransformSystem& transforms, const std::vector<glm::vec3>& positions);
+CameraPose currentCameraPose();
+void setShaderUniforms(Shader& shader, Shader& instancedShader, Uniform<glm::mat4>& modelUniform);
+int renderSoftware(int frameCount, int warmupFrames, const char* benchmarkScript, const char* outputPath, const char* reportPath,
+	int cubeCount, bool cull, int threadCount, GoldenSuite* golden);
 
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -31,73 +64,13 @@ const float MouseSensitivity = 0.1f;
 const int SCR_WIDTH = 800;
 const int SCR_HEIGHT = 600;
 
-int main()
-{
-	// Set defaults.
-	lastX = SCR_WIDTH / 2;
-	lastY = SCR_HEIGHT / 2;
-
-	// Initialize and configure GLFW
-	// -----------------------------
-	glfwInit();
-
-	// Tell GLFW which version of OpenGL we want to use.
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-
-	// Tell GLFW which OpenGL we want to use (should always be core profile).
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	// GLFW window creation
-	// --------------------
-	GLFWwindow* window = glfwCreateWindow(800, 600, "opengl-getting-started", NULL, NULL);
-	if (window == NULL)
-	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
-	}
-
-	// Tell GLFW to make the context of our window the main context on the current thread.
-	glfwMakeContextCurrent(window);
-	
-	// Tell GLFW to register the framebuffer callback to handle window resizing.
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-	// Tell GLFW to hide and capture the cursor.
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// Tell GLFW what function to call whenever the mouse cursor moves.
-	glfwSetCursorPosCallback(window, mouse_callback);
-
-	// Tell GLFW what function to call on mouse scrolling.
-	glfwSetScrollCallback(window, scroll_callback);
-
-	// Load all OpenGL function pointers for GLAD
-	// ------------------------------------------
-	// Loads all OpenGL function pointers based on the version we told it to use (in this instance OpenGL v3.3).
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
-	}
-
-	glEnable(GL_DEPTH_TEST);
-
-	// Build and compile our shader program
-	// ------------------------------------
-	Shader shader("shader.vs", "shader.fs");
-
-	// Setup up vertex data (an buffers) and configure vertex attributes
-	// -----------------------------------------------------------------
-
-	// Vertices in normalized device coordinated (NDC).
-	// OpenGL only processes 3D coordinates when they're in a specific range between -1.0 and 1.0 on all 3 axes (x, y and z).
-	// This range is called the normalized device coordinates range and only coordinates within this range will be depicted on the screen.
-	// All other coordinated outside of the range will be discarded.
-	// Texture coordinates are used to map a 2D texture to the object, in this case the triangle,
-	// and range from 0 to 1 on the x and y axis, relative to the object we want to draw.
-	float vertices[] = {
+// Vertices in normalized device coordinated (NDC).
+// OpenGL only processes 3D coordinates when they're in a specific range between -1.0 and 1.0 on all 3 axes (x, y and z).
+// This range is called the normalized device coordinates range and only coordinates within this range will be depicted on the screen.
+// All other coordinated outside of the range will be discarded.
+// Texture coordinates are used to map a 2D texture to the object, in this case the triangle,
+// and range from 0 to 1 on the x and y axis, relative to the object we want to draw.
+const float cubeVertices[] = {
 	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
 	 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
 	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
@@ -139,7 +112,285 @@ int main()
 	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
 	-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
 	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-	};
+};
+
+// Let's make 10 different cubes at various locations.
+const glm::vec3 initialCubePositions[] = {
+	glm::vec3( 0.0f,  0.0f,  0.0f),
+	glm::vec3( 2.0f,  5.0f, -15.0f),
+	glm::vec3(-1.5f, -2.2f, -2.5f),
+	glm::vec3(-3.8f, -2.0f, -12.3f),
+	glm::vec3( 2.4f, -0.4f, -3.5f),
+	glm::vec3(-1.7f,  3.0f, -7.5f),
+	glm::vec3( 1.3f, -2.0f, -2.5f),
+	glm::vec3( 1.5f,  2.0f, -2.5f),
+	glm::vec3( 1.5f,  0.2f, -1.5f),
+	glm::vec3(-1.3f,  1.0f, -1.5f)
+};
+
+int main(int argc, char* argv[])
+{
+	// Set defaults.
+	lastX = SCR_WIDTH / 2;
+	lastY = SCR_HEIGHT / 2;
+
+	// Parse command line options.
+	//	--headless			render offscreen through EGL instead of opening a window (no display or GPU required)
+	//	--frames <count>	number of frames to render in headless or benchmark mode before exiting
+	//	--output <file>		write the last headless frame to a PNG file
+	//	--benchmark <name>	replay a fixed camera script (static, orbit, flythrough) instead of reading input, and report frame timings
+	//	--warmup <count>	number of frames excluded from the timings at the start of the run
+	//	--report <file>		write the frame timings to a CSV file, or JSON when the file ends with .json
+	//	--cubes <count>		number of cubes in the scene (defaults to the 10 hand placed ones)
+	//	--instanced			draw all cubes with a single instanced draw call instead of one draw call per cube
+	//	--profile			time the parts of every frame on the CPU and the GPU, and show the timings in an overlay
+	//	--trace <file>		write the profiled frames as a Chrome trace (chrome://tracing), implies profiling
+	//	--no-persistent-mapping	stream the instance data by mapping the buffer every frame, like on OpenGL 3.3, even when buffer storage is available
+	//	--indexed			draw the cube from a welded, vertex cache optimized index buffer instead of 36 separate vertices
+	//	--mesh <file>		draw the cubes with a mesh from a binary mesh file instead of the built-in cube (implies --indexed)
+	//	--convert-mesh <input.obj> <output.mesh>	convert an OBJ file into a binary mesh file, and exit
+	//	--vertex-format <format>	vertex format of --indexed and --convert-mesh: float (default), packed, or e.g. position=half,texcoord=unorm16
+	//	--shader-cache <directory>	directory of the program binary cache (defaults to shadercache)
+	//	--no-shader-cache	always compile the shaders from source
+	//	--hot-reload		rebuild the shaders whenever their source files are saved (Linux only)
+	//	--cull				only draw the cubes inside the view frustum
+	//	--sort				draw the cubes in render queue order (front to back) instead of the order they're stored in
+	//	--pipelined			simulate and prepare frames on their own threads, ahead of the render thread submitting them
+	//	--check-allocations	fail when any frame after the warmup allocates from the heap (OpenGL rendering only)
+	//	--microbenchmark <name>	run a CPU-only microbenchmark (culling, sort, transforms, hierarchy, jobs, arena) instead of rendering, and exit
+	//	--objects <count>	number of objects in the microbenchmark (defaults to 1 million)
+	//	--software			render on the CPU with the software rasterizer instead of OpenGL (implies a fixed number of frames, like --headless)
+	//	--threads <count>	number of threads the software rasterizer uses (defaults to one per core)
+	//	--golden <directory>	render the golden image camera poses and compare them against the golden images in the directory
+	//	--update-golden		store the rendered golden images in the --golden directory instead of comparing against them
+	bool headless = false;
+	int frameCount = 100;
+	int warmupFrames = 10;
+	const char* outputPath = NULL;
+	const char* benchmarkScript = NULL;
+	const char* reportPath = NULL;
+	int cubeCount = 10;
+	bool instanced = false;
+	bool persistentMapping = true;
+	bool profile = false;
+	const char* tracePath = NULL;
+	bool indexed = false;
+	const char* meshPath = NULL;
+	const char* convertInput = NULL;
+	const char* convertOutput = NULL;
+	const char* vertexFormatSpec = "float";
+	const char* shaderCacheDirectory = "shadercache";
+	bool hotReload = false;
+	bool cull = false;
+	bool sortDraws = false;
+	bool pipelined = false;
+	bool checkAllocations = false;
+	const char* microbenchmark = NULL;
+	int objectCount = 1000000;
+	bool software = false;
+	int threadCount = 0;
+	const char* goldenDirectory = NULL;
+	bool updateGolden = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+			benchmarkScript = argv[++i];
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmupFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+			reportPath = argv[++i];
+		else if (strcmp(argv[i], "--cubes") == 0 && i + 1 < argc)
+			cubeCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--instanced") == 0)
+			instanced = true;
+		else if (strcmp(argv[i], "--profile") == 0)
+			profile = true;
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (strcmp(argv[i], "--no-persistent-mapping") == 0)
+			persistentMapping = false;
+		else if (strcmp(argv[i], "--indexed") == 0)
+			indexed = true;
+		else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+			meshPath = argv[++i];
+		else if (strcmp(argv[i], "--convert-mesh") == 0 && i + 2 < argc)
+		{
+			convertInput = argv[++i];
+			convertOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc)
+			vertexFormatSpec = argv[++i];
+		else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+			shaderCacheDirectory = argv[++i];
+		else if (strcmp(argv[i], "--hot-reload") == 0)
+			hotReload = true;
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+			shaderCacheDirectory = "";
+		else if (strcmp(argv[i], "--cull") == 0)
+			cull = true;
+		else if (strcmp(argv[i], "--sort") == 0)
+			sortDraws = true;
+		else if (strcmp(argv[i], "--pipelined") == 0)
+			pipelined = true;
+		else if (strcmp(argv[i], "--check-allocations") == 0)
+			checkAllocations = true;
+		else if (strcmp(argv[i], "--microbenchmark") == 0 && i + 1 < argc)
+			microbenchmark = argv[++i];
+		else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+			objectCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--software") == 0)
+			software = true;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+			goldenDirectory = argv[++i];
+		else if (strcmp(argv[i], "--update-golden") == 0)
+			updateGolden = true;
+		else
+		{
+			std::cout << "Unknown option: " << argv[i] << std::endl;
+			return -1;
+		}
+	}
+
+	if (benchmarkScript && !CameraScript::exists(benchmarkScript))
+	{
+		std::cout << "Unknown benchmark camera script: " << benchmarkScript << std::endl;
+		return -1;
+	}
+
+	VertexFormat vertexFormat;
+	if (!VertexFormat::parse(vertexFormatSpec, vertexFormat))
+	{
+		std::cout << "Unknown vertex format: " << vertexFormatSpec << std::endl;
+		return -1;
+	}
+
+	// Meshes are converted offline, without a window or context.
+	if (convertInput)
+		return MeshConverter::convertObj(convertInput, convertOutput, vertexFormat, std::cout) ? 0 : -1;
+
+	// Microbenchmarks don't render anything, so they don't need a window or context either.
+	if (microbenchmark)
+	{
+		if (!Microbenchmarks::exists(microbenchmark))
+		{
+			std::cout << "Unknown microbenchmark: " << microbenchmark << std::endl;
+			return -1;
+		}
+
+		std::vector<glm::vec3> objectPositions;
+		generateCubePositions(objectPositions, objectCount);
+		return Microbenchmarks::run(microbenchmark, objectPositions, std::cout) ? 0 : -1;
+	}
+
+	// The golden image suite renders one frame per camera pose, offscreen and at the size of the golden images.
+	GoldenSuite goldenSuite(goldenDirectory ? goldenDirectory : "", updateGolden);
+	GoldenSuite* golden = goldenDirectory ? &goldenSuite : NULL;
+	if (golden)
+	{
+		headless = true;
+		frameCount = (int)GoldenSuite::poses().size();
+		warmupFrames = 0;
+	}
+
+	// The software rasterizer only needs the CPU, so it doesn't create a window or an OpenGL context at all.
+	if (software)
+		return renderSoftware(frameCount, warmupFrames, benchmarkScript, outputPath, reportPath, cubeCount, cull, threadCount, golden);
+
+	// Headless and benchmark runs render a fixed number of frames.
+	bool fixedFrameCount = headless || benchmarkScript;
+
+	GLFWwindow* window = NULL;
+	HeadlessContext headlessContext;
+
+	if (headless)
+	{
+		// Create an offscreen context instead of a window. This also loads the OpenGL function pointers for GLAD.
+		if (!headlessContext.create(golden ? GoldenSuite::Width : SCR_WIDTH, golden ? GoldenSuite::Height : SCR_HEIGHT))
+			return -1;
+	}
+	else
+	{
+#ifdef PLAYGROUND_HEADLESS_ONLY
+		std::cout << "Built without GLFW, only --headless and --software rendering are available" << std::endl;
+		return -1;
+#else
+		// Initialize and configure GLFW
+		// -----------------------------
+		glfwInit();
+
+		// Tell GLFW which version of OpenGL we want to use.
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+
+		// Tell GLFW which OpenGL we want to use (should always be core profile).
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		// GLFW window creation
+		// --------------------
+		window = glfwCreateWindow(800, 600, "opengl-getting-started", NULL, NULL);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+
+		// Tell GLFW to make the context of our window the main context on the current thread.
+		glfwMakeContextCurrent(window);
+	
+		// Tell GLFW to register the framebuffer callback to handle window resizing.
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+		// Tell GLFW to hide and capture the cursor.
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// Tell GLFW what function to call whenever the mouse cursor moves.
+		glfwSetCursorPosCallback(window, mouse_callback);
+
+		// Tell GLFW what function to call on mouse scrolling.
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// Load all OpenGL function pointers for GLAD
+		// ------------------------------------------
+		// Loads all OpenGL function pointers based on the version we told it to use (in this instance OpenGL v3.3).
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			std::cout << "Failed to initialize GLAD" << std::endl;
+			return -1;
+		}
+
+		// Load the functionality GLAD doesn't cover, if the driver supports it.
+		glExtensions().load((GLADloadproc)glfwGetProcAddress);
+#endif
+	}
+
+	// All state changes go through the render state cache, which drops the ones that wouldn't change anything.
+	renderState().setDepthTest(true);
+
+	// Build and compile our shader program
+	// ------------------------------------
+	// Linked programs are cached on disk, so only the very first launch has to wait for the GLSL compiler.
+	// The shader library only submits the shaders here, the driver compiles them (in parallel, if it can) while we set up the rest.
+	ShaderCache shaderCache(shaderCacheDirectory);
+	ShaderLibrary shaderLibrary(&shaderCache);
+	shaderLibrary.create();
+
+	Shader& shader = *shaderLibrary.load("shader.vs", "shader.fs");
+
+	// The instanced shader reads the model matrix from a per-instance vertex attribute instead of a uniform.
+	Shader& instancedShader = *shaderLibrary.load("instanced.vs", "shader.fs");
+
+	// Setup up vertex data (an buffers) and configure vertex attributes
+	// -----------------------------------------------------------------
+	// The cube's vertices are defined at the top of the file (cubeVertices), as the software rasterizer draws them too.
 
 	// Drawing other shapes that triangles, but with the basis of a triangle as OpenGL prefers triangles.
 	// By utilizing indices (known as indexed drawing) and element buffer objects (EBO), we can combine to triangles to draw a rectangle,
@@ -149,11 +400,54 @@ int main()
 	//	1, 2, 3   // second triangle
 	//};
 
+	// Instead of writing the indices by hand, we can let the mesh builder find the duplicate vertices for us.
+	// It welds identical vertices together (the cube's 36 vertices only have 16 unique ones), then reorders the triangles so the GPU's
+	// post-transform cache can reuse as many vertex shader results as possible, and finally reorders the vertices
+	// so they're fetched from memory in order.
+	IndexedMesh cubeMesh;
+	PackedVertices cubeVertexData;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+
+	// Meshes from files were welded and optimized when they were converted, they're only mapped into memory here.
+	MeshFile meshFile;
+	if (meshPath)
+	{
+		if (!meshFile.open(meshPath))
+			return -1;
+
+		indexed = true;
+		indexCount = (GLsizei)meshFile.Header->IndexCount;
+		indexType = meshFile.Header->IndexType;
+		std::cout << "Mesh " << meshPath << ": " << meshFile.Header->VertexCount << " vertices, " << indexCount / 3 << " triangles" << std::endl;
+	}
+	else if (indexed)
+	{
+		const size_t vertexCount = sizeof(cubeVertices) / (5 * sizeof(float));
+		cubeMesh = MeshBuilder::weld(cubeVertices, vertexCount, 5);
+		VertexCacheStatistics welded = VertexCacheStatistics::analyze(cubeMesh.Indices.data(), cubeMesh.Indices.size(), cubeMesh.vertexCount());
+
+		MeshBuilder::optimizeVertexCache(cubeMesh);
+		MeshBuilder::optimizeVertexFetch(cubeMesh);
+		indexCount = (GLsizei)cubeMesh.Indices.size();
+		VertexCacheStatistics optimized = VertexCacheStatistics::analyze(cubeMesh.Indices.data(), cubeMesh.Indices.size(), cubeMesh.vertexCount());
+
+		// Without indices every vertex is transformed, so the ACMR is always 3 and every unique vertex is transformed multiple times.
+		std::cout << "Indexed mesh: " << vertexCount << " -> " << cubeMesh.vertexCount() << " vertices, " << cubeMesh.Indices.size() / 3 << " triangles" << std::endl;
+		std::cout << "  non-indexed: ACMR 3, ATVR " << (float)vertexCount / cubeMesh.vertexCount() << std::endl;
+		std::cout << "  welded:      ACMR " << welded.ACMR << ", ATVR " << welded.ATVR << std::endl;
+		std::cout << "  optimized:   ACMR " << optimized.ACMR << ", ATVR " << optimized.ATVR << std::endl;
+
+		// Compile the vertices into the requested vertex format, e.g. 16-bit positions and texture coordinates instead of floats.
+		if (!vertexFormat.compile(cubeMesh, cubeVertexData, &std::cout))
+			return -1;
+	}
+
 	// All OpenGL buffer objects have a unique ID corresponding to that specific buffer, in this case:
 	//		- vertex array object (VAO)
 	//		- vertex buffer object (VBO)
 	//		- element buffer object (EBO)
-	unsigned int VAO, VBO;//, EBO;
+	unsigned int VAO, VBO, EBO = 0;
 
 	// Instantiate the vertex array object.
 	// A vertex array object can be bound just like a vert buffer. All subsequent vertex attribute calls (glVertexAttribPointer, glEnableVertexAttribArray)
@@ -173,22 +467,35 @@ int main()
 	//glGenBuffers(1, &EBO);
 
 	// Bind vertex array object (VAO) first, then bind and set vertex buffer object(s) (VBO), and then configure vertex attribute(s).
-	glBindVertexArray(VAO);
+	renderState().bindVertexArray(VAO);
 
 	// The buffer type of a vertex buffer object is GL_ARRAY_BUFFER.
 	// Bind the vertex buffer to the GL_ARRAY_BUFFER target.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	renderState().bindBuffer(GL_ARRAY_BUFFER, VBO);
 
 	// Now, all buffer calls we make on the target GL_ARRAY_BUFFER will be used to configure the bound buffer, which in this case is VBO.
 	// Copy the vertices data to the buffer, meaning that we copy the data to the memory of the graphics card.
 	//	GL_STREAM_DRAW: the data is set only once and used by the GPU at most a few times.
 	//	GL_STATIC_DRAW: the data is set only once and used many times.
 	//	GL_DYNAMIC_DRAW : the data is changed a lot and used many times.
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// A mesh file's vertices are handed to OpenGL straight from the mapped file, there's nothing to decode.
+	if (meshPath)
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)meshFile.Header->VertexSize, meshFile.vertices(), GL_STATIC_DRAW);
+	else if (indexed)
+		glBufferData(GL_ARRAY_BUFFER, cubeVertexData.Data.size(), cubeVertexData.Data.data(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
 
-	// Bind EBO.
-	//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	//glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	// Instantiate and bind the EBO. The element buffer binding is stored in the bound VAO.
+	if (indexed)
+	{
+		glGenBuffers(1, &EBO);
+		renderState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		if (meshPath)
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)meshFile.Header->IndexSize, meshFile.indices(), GL_STATIC_DRAW);
+		else
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, cubeMesh.Indices.size() * sizeof(unsigned int), cubeMesh.Indices.data(), GL_STATIC_DRAW);
+	}
 
 	// Linking vertex attributes.
 	// We now added the vertex data to the GPU memory, as well as instructed the GPU how to handle the vertex data within a vertex and fragment shader.
@@ -222,6 +529,17 @@ int main()
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	glEnableVertexAttribArray(1);
 
+	// A mesh file or vertex format describes its own vertex layout, which replaces the cube's. Once uploaded, the file isn't needed anymore.
+	if (meshPath)
+	{
+		meshFile.setAttributePointers();
+		meshFile.close();
+	}
+	else if (indexed)
+	{
+		cubeVertexData.setAttributePointers();
+	}
+
 	// Generating textures
 	// -------------------
 
@@ -229,135 +547,246 @@ int main()
 	// OpenGL expectes the 0.0 coordinate on the y-aixs to be on the bottom side of the image, but images usually have 0.0 at the top of the y-axis.
 	stbi_set_flip_vertically_on_load(true);
 
-	// Generate an OpenGL texture object.
-	unsigned int texture1, texture2;
-
-	// Generate and configure texture1
-	// -------------------------------
-	glGenTextures(1, &texture1);
-
-	// Bind the created texture to the GL_TEXTURE_2D target.
-	glBindTexture(GL_TEXTURE_2D, texture1);
-
-	// Set the texture wrapping options (on the currently bound texture object).
-	// - 1st argument specifies the target, in this case, as we're working with a 2D texture, the target is GL_TEXTURE_2D.
-	// - 2nd argument specifies what option we want to set and for which texture axis (S/T is basically U/V)
-	// - 3rd argument specifies the wrapping mode
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// If the above glTexParameteri has been set to use wrap mode GL_CLAMP_TO_BORDER, we'd need to specify a border color, with the below 2 lines.
-	//float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-	//glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-	// Set the texture filtering method (on the currently bound texture object).
-	// GL_NEAREST (also known as nearest neighbor or point filtering) is the default filtering method of OpenGL.
-	// - With GL_NEAREST, OpenGL selected the texture pixel (also known as a texel) that center us closest to on the texture coordinate.
-	// - With GL_LINEAR (also known as (bi)linear filtering), OpenGL takes an interpreted value from the texture coordinates neighboring texels,
-	//	 approximating a color between the texels.
-	// GL_LINEAR usually produces a more realistic output, whereas GL_NEAREST produces a more 8-bit look (more pixelated look).
-	// Texture filtering can be set individually for magnifying operations (when scaling up) or minifying operations (when scaling down).
-	// This allows us to differentiate the method used when scaling down (GL_TEXTURE_MIN_FILTER) as opposed to scaling up (GL_TEXTURE_MAG_FILTER).
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Load a texture image using stb_image.h
-	int width, height, nrChannels;
-
-	// The function stbi_load (from stb_image.h library) first  takes an image (container.jpg) and provides us with the width, height and number of color channels.
-	// Width and height is used to later generate textures.
-	unsigned char* data = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
-	if (data)
-	{
-		// Once the texture has been created and bound, we can generate a texture with the loaded image data using glTexImage2D.
-		// - 1st argument specifies the texture target, generating a texture on the currently bound texture object on the target, in this case GL_TEXTURE_2D and the texture created using glGenTextures.
-		// - 2nd argument specifies the mipmap level for which we want to create a texture for, if you may want to set each mipmap level manually.
-		// - 3rd argument specifies what kind of format we want to store the texture in, in OpenGL. The image only has RGB values, so we'll store the texture with RGB values as well.
-		// - 4th and 5th arguments specifies the width and the height of the image.
-		// - 6th argument should always be hardcoded as 0 (legacy stuff).
-		// - 7th and 0th arguments specifies the format and the data type of the source image. As we've loaded the image with RGB values and stored them as chars (bytes), we'll pass in the correponding values (GL_RGB and GL_UNSIGNED_BYTE).
-		// - 8th argument specifies the actual image (the data we loaded).
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
+	// Decode the images on worker threads, the textures show a placeholder until the render loop uploads the decoded images.
+	TextureLoader textureLoader;
+	unsigned int texture1 = textureLoader.load("container.jpg");
+	unsigned int texture2 = textureLoader.load("awesomeface.png");
+
+	// Wait for the shaders the driver is still working on.
+	shaderLibrary.finish();
+	shaderLibrary.printStatistics(std::cout);
+	shaderCache.printStatistics(std::cout);
+
+	// Tell OpenGL which texture unit each shader sampler belongs to, and look up the uniforms we set every frame.
+	Uniform<glm::mat4> modelUniform;
+	setShaderUniforms(shader, instancedShader, modelUniform);
+
+	// Rebuild the shaders when their files are edited, so shader changes show up without restarting.
+	ShaderWatcher shaderWatcher;
+	if (hotReload)
 	{
-		// If we somehow failed to load the image.
-		std::cout << "Failed to load texture" << std::endl;
+		shaderWatcher.watch(&shader);
+		shaderWatcher.watch(&instancedShader);
+		shaderWatcher.start();
 	}
 
-	// Wants the texture and its corresponding mipmaps have been generated, we free the image memory using stbi_image_free
-	stbi_image_free(data);
+	// The camera matrices are shared by every shader through the Frame uniform block, so they're written once per frame
+	// into a uniform buffer object, rather than set on each program.
+	UniformBuffer<FrameUniforms> frameUniforms;
+	frameUniforms.create(FrameBlockBinding);
+
+	// Using GLM to create an orthographic projection matrix.
+	//glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, 0.1f, 100.0f);
 
-	// Generate and configure texture2
-	// -------------------------------
+	// Using GLM to create a perspective projection matrix.
+	//glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
 
-	glGenTextures(1, &texture2);
-	// Bind other texture.
-	glBindTexture(GL_TEXTURE_2D, texture2);
 
-	// Set wrapping.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Any cubes beyond the first 10 are scattered around them, to stress test the renderer.
+	std::vector<glm::vec3> cubePositions(initialCubePositions, initialCubePositions + 10);
+	generateCubePositions(cubePositions, cubeCount);
 
-	// Set texture filtering.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// The cubes never move, so their model matrices are only built by the first update(), after that they're all clean.
+	TransformSystem cubeTransforms;
+	addCubeTransforms(cubeTransforms, cubePositions);
 
-	// The function stbi_load (from stb_image.h library) first  takes an image (container.jpg) and provides us with the width, height and number of color channels.
-	// Width and height is used to later generate textures.
-	data = stbi_load("awesomeface.png", &width, &height, &nrChannels, 0);
-	if (data)
+	// The instanced path needs room for a model matrix per cube in the instance buffer, every frame.
+	InstancedRenderer instancedRenderer;
+	if (instanced)
 	{
-		// As awesomeface.png has transparency and thus an alpha channel, we need to tell OpenGL that the data type is of GL_RGBA.
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		instancedRenderer.create(VAO, (int)cubePositions.size(), persistentMapping);
+		std::cout << "Instance buffer: " << (instancedRenderer.Instances.Persistent ? "persistently mapped" : "mapped every frame") << std::endl;
 	}
-	else
+
+	// With culling, every cube is bounded by a sphere around its center: the radius is half the cube's diagonal,
+	// so the sphere contains the cube no matter how it's rotated.
+	BoundingSpheres cubeBounds;
+	FrustumCuller culler;
+	if (cull)
 	{
-		// If we somehow failed to load the image.
-		std::cout << "Failed to load texture" << std::endl;
+		cubeBounds.reserve(cubePositions.size());
+		for (unsigned int i = 0; i < cubePositions.size(); i++)
+			cubeBounds.push_back(cubePositions[i], 0.8660254f);
 	}
 
-	// Wants the texture and its corresponding mipmaps have been generated, we free the image memory using stbi_image_free
-	stbi_image_free(data);
+	// With sorting, the draw list is put in render queue order every frame.
+	RenderQueue renderQueue;
+	if (sortDraws)
+		renderQueue.reserve(cubePositions.size());
+
+	// Scoped CPU and GPU timings of the parts of every frame, shown in an overlay on top of the frame.
+	GpuProfiler profiler;
+	ProfilerOverlay profilerOverlay;
+	if (profile || tracePath)
+		profiler.create(tracePath != NULL);
+	if (profile)
+		profilerOverlay.create(&shaderCache);
+
+	// Records the CPU and GPU time of every frame of a headless or benchmark run.
+	CameraScript cameraScript(benchmarkScript ? benchmarkScript : "static");
+	BenchmarkRecorder recorder(warmupFrames);
+	recorder.Renderer = (const char*)glGetString(GL_RENDERER);
+	if (fixedFrameCount)
+		recorder.reserve(frameCount);
+
+	// Headless and benchmark runs have to render the same frames every time, so they can't start with placeholder textures.
+	if (fixedFrameCount)
+		textureLoader.finish();
+
+	// The CPU side of a frame: the simulation moves the camera (the cubes stand still), then the draws are prepared for it, without
+	// any OpenGL calls. Normally both run on the render thread right before the frame is submitted. With --pipelined they run on
+	// threads of their own, a few frames ahead of the render thread (see FramePipeline.h), so they only touch data of their own stage.
+	FramePipeline framePipeline;
+	auto simulate = [&](int simulationFrame, SimulationFrame& simulation)
+	{
+		simulation.Frame = simulationFrame;
+		if (golden || benchmarkScript)
+			simulation.Camera = golden ? GoldenSuite::evaluate(GoldenSuite::poses()[simulationFrame]) : cameraScript.evaluate(simulationFrame);
+		else
+			simulation.Camera = pipelined ? framePipeline.camera() : currentCameraPose();
+
+		// Benchmarks use the script's fixed timestep for the time too, so every run renders the same frames.
+#ifdef PLAYGROUND_HEADLESS_ONLY
+		float time = (float)headlessContext.getTime();
+#else
+		float time = headless ? (float)headlessContext.getTime() : (float)glfwGetTime();
+#endif
+		simulation.Time = benchmarkScript ? simulationFrame * CameraScript::TimeStep : time;
+	};
 
-	shader.use();
+	// The profiler times scopes with OpenGL queries, so the pipeline's threads don't profile their work.
+	GpuProfiler pipelineProfiler;
+	GpuProfiler& prepareProfiler = pipelined ? pipelineProfiler : profiler;
+	auto prepare = [&](const SimulationFrame& simulation, RenderFrame& render)
+	{
+		const CameraPose& camera = simulation.Camera;
 
-	// Tell OpenGL which texture unit each shader sampler belongs to.
-	shader.setInt("texture1", 0);
-	shader.setInt("texture2", 1);
+		// The view matrix can be thought of as the camera of the player or the viewer.
+		glm::mat4 view = glm::lookAt(camera.Position, camera.Position + camera.Front, cameraUp);
 
-	// Using GLM to create an orthographic projection matrix.
-	//glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, 0.1f, 100.0f);
+		// The projection matrix defines whether we're using perspective or orthographic projection.
+		glm::mat4 projection = glm::mat4(1.0f);
+		projection = glm::perspective(glm::radians(camera.FOV), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+		render.Frame = simulation.Frame;
+		render.Uniforms.View = view;
+		render.Uniforms.Projection = projection;
+		render.Uniforms.ViewProjection = projection * view;
+		render.Uniforms.CameraPosition = camera.Position;
+		render.Uniforms.Time = simulation.Time;
+
+		// The indices of the cubes to draw this frame, and later their model matrices, live in the frame's arena.
+		// Both lists get room for every cube: claiming arena memory costs nothing, and the arena settles at the same size every frame
+		// instead of growing whenever more cubes than ever before are visible.
+		render.reset();
+		FrameVector<unsigned int>& drawList = render.DrawList;
+		drawList.reserve(cubePositions.size());
+		render.Models.reserve(cubePositions.size());
+
+		// Skip the cubes that can't end up on screen, before spending any time on their model matrices or draw calls.
+		if (cull)
+		{
+			ProfileScope scope(prepareProfiler, "culling");
+			culler.cull(Frustum::fromMatrix(render.Uniforms.ViewProjection), cubeBounds, drawList);
+		}
+		else
+		{
+			// Without culling that's simply every cube.
+			for (unsigned int i = 0; i < cubePositions.size(); i++)
+				drawList.push_back(i);
+		}
+		render.Visible = drawList.size();
+		render.Culled = cubePositions.size() - drawList.size();
 
-	// Using GLM to create a perspective projection matrix.
-	//glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
+		// Every cube uses the same shader, textures and vertex array, so their sort keys only differ in depth:
+		// the cubes are drawn front to back, and the depth test discards the hidden parts of the cubes behind them before shading.
+		if (sortDraws)
+		{
+			ProfileScope scope(prepareProfiler, "sort");
+			renderQueue.clear();
+			for (unsigned int i = 0; i < drawList.size(); i++)
+			{
+				float depth = glm::dot(cubePositions[drawList[i]] - camera.Position, camera.Front);
+				renderQueue.push(RenderQueue::opaqueKey(OpaquePass, 0, 0, 0, RenderQueue::depthBits(depth, 0.1f, 100.0f)), drawList[i]);
+			}
+			renderQueue.sort();
+
+			for (unsigned int i = 0; i < drawList.size(); i++)
+				drawList[i] = renderQueue.Packets[i].Object;
+		}
 
-	// Let's make 10 different cubes at various locations.
-	glm::vec3 cubePositions[] = {
-		glm::vec3( 0.0f,  0.0f,  0.0f),
-		glm::vec3( 2.0f,  5.0f, -15.0f),
-		glm::vec3(-1.5f, -2.2f, -2.5f),
-		glm::vec3(-3.8f, -2.0f, -12.3f),
-		glm::vec3( 2.4f, -0.4f, -3.5f),
-		glm::vec3(-1.7f,  3.0f, -7.5f),
-		glm::vec3( 1.3f, -2.0f, -2.5f),
-		glm::vec3( 1.5f,  2.0f, -2.5f),
-		glm::vec3( 1.5f,  0.2f, -1.5f),
-		glm::vec3(-1.3f,  1.0f, -1.5f)
+		// Gather the model matrix of every cube to draw, in draw order.
+		ProfileScope scope(prepareProfiler, "transforms");
+		cubeTransforms.update();
+		render.Models.resize(drawList.size());
+		for (unsigned int i = 0; i < drawList.size(); i++)
+			render.Models[i] = cubeTransforms.Matrices[drawList[i]];
 	};
 
-	// Render loop - continue to run until GLFW has been instructed to close.
-	while (!glfwWindowShouldClose(window))
+	SimulationFrame inlineSimulation;
+	RenderFrame inlineRender;
+	if (pipelined)
+	{
+		framePipeline.setCamera(currentCameraPose());
+		framePipeline.start(fixedFrameCount ? frameCount : -1, simulate, prepare);
+		std::cout << "Frame pipeline: simulation and preparation run on their own threads" << std::endl;
+	}
+
+	// Render loop - continue to run until GLFW has been instructed to close, or until all headless/benchmark frames have been rendered.
+	// Builds without GLFW never get here without --headless.
+	int frame = 0;
+#ifdef PLAYGROUND_HEADLESS_ONLY
+	while (frame < frameCount)
 	{
-		float currentFrame = glfwGetTime();
+		float currentFrame = (float)headlessContext.getTime();
+#else
+	while (fixedFrameCount ? frame < frameCount : !glfwWindowShouldClose(window))
+	{
+		float currentFrame = headless ? (float)headlessContext.getTime() : (float)glfwGetTime();
+#endif
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		if (fixedFrameCount)
+			recorder.beginFrame();
+		profiler.beginFrame();
+		renderState().resetCounters();
+
+		// Upload any textures that finished loading in the background.
+		profiler.beginScope("textures");
+		textureLoader.update();
+		profiler.endScope();
+
+		// Swap in the shaders that were edited. A new program starts out with default uniform values, so they're set again.
+		if (hotReload && shaderWatcher.update() > 0)
+			setShaderUniforms(shader, instancedShader, modelUniform);
+
 		// Handle input
 		// ------------
-		processInput(window);
+		// Camera scripts replay the camera instead of reading keyboard and mouse, so every run renders the same frames.
+		if (!golden && !benchmarkScript && !headless)
+		{
+			processInput(window);
+			if (pipelined)
+				framePipeline.setCamera(currentCameraPose());
+		}
+
+		// Simulate and prepare the frame, or take the next one the pipeline prepared.
+		RenderFrame* render = &inlineRender;
+		if (pipelined)
+		{
+			ProfileScope scope(profiler, "pipeline wait");
+			render = framePipeline.acquire();
+		}
+		else
+		{
+			simulate(frame, inlineSimulation);
+			prepare(inlineSimulation, inlineRender);
+		}
+		if (!render)
+			break;
+		if (cull)
+			recorder.countCulling(render->Visible, render->Culled);
 
 		// Render
 		// ------
@@ -365,7 +794,9 @@ int main()
 		// Define the color we want to clear the buffer with.
 		glClearColor(0.f, 0.3f, 0.3f, 1.0f);
 
+		profiler.beginScope("clear");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler.endScope();
 
 		// Clear the buffer (the specific buffer we're clearing is defined by GL_COLOR_BUFFER_BIT).
 		// Whenever we call glClear and clear the color buffer, the entire color buffer will be filled with the color as configured by glClearColor.
@@ -377,11 +808,9 @@ int main()
 		//float greenValue = (sin(timeValue) / 2.0f) + 0.5f;
 
 		// Bind texture object.
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
+		// The textures never change, so after the first frame the render state cache skips these (and the glActiveTexture calls).
+		renderState().bindTexture(0, texture1);
+		renderState().bindTexture(1, texture2);
 
 		// Before we can set the color on the uniform type, we need to find it within our shader program.
 		//int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
@@ -398,32 +827,53 @@ int main()
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // To reverse wireframe mode back to solid.
 
-		// The view matrix can be thought of as the camera of the player or the viewer.
-		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-
-		shader.setMat4("view", view);
+		frameUniforms.update(render->Uniforms);
 
-		// The projection matrix defines whether we're using perspective or orthographic projection.
-		glm::mat4 projection = glm::mat4(1.0f);
-		projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		shader.setMat4("projection", projection);
-
-		// Bind out VAO (the triangle information)
-		glBindVertexArray(VAO);
-		for (unsigned int i = 0; i < 10; i++)
+		const FrameVector<glm::mat4>& models = render->Models;
+		if (instanced)
+		{
+			// Upload every cube's model matrix at once and draw all cubes with a single draw call.
+			ProfileScope scope(profiler, "cubes");
+			instancedShader.use();
+
+			// The matrices are copied straight into the instance buffer, there's no other copy to upload.
+			// map() may clamp the count to the buffer's capacity, so only that many are copied.
+			glm::mat4* instanceModels = instancedRenderer.map((int)models.size());
+			if (instanceModels)
+			{
+				memcpy(instanceModels, models.data(), (size_t)instancedRenderer.Count * sizeof(glm::mat4));
+				instancedRenderer.unmap();
+			}
+
+			if (indexed)
+				instancedRenderer.drawIndexed(indexCount, indexType);
+			else
+				instancedRenderer.draw(36);
+			recorder.countDrawCalls(1);
+		}
+		else
 		{
-			// The model matrix defines the transform properties of the object.
-			// The matrix consists of: location (translate) rotation, and scale.
-			glm::mat4 model = glm::mat4(1.0f);
-			// Model translation defines the objects world location.
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			shader.setMat4("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			ProfileScope scope(profiler, "cubes");
+			shader.use();
+
+			// Bind out VAO (the triangle information)
+			renderState().bindVertexArray(VAO);
+			for (unsigned int i = 0; i < models.size(); i++)
+			{
+				shader.set(modelUniform, models[i]);
+
+				if (indexed)
+					glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+				else
+					glDrawArrays(GL_TRIANGLES, 0, 36);
+			}
+			recorder.countDrawCalls((int)models.size());
 		}
 
+		// Every draw reading the frame has been issued, so the preparation thread can reuse it.
+		if (pipelined)
+			framePipeline.release();
+
 		// Draw based on vertex buffer object (VBO).
 		// NOTE: The pure glDrawArrays is only relevant when no element buffer object (EBO) is in play.
 		// - 1st argument specifices the primitive shape that'll be our basis
@@ -457,14 +907,119 @@ int main()
 		// The front buffer contains the final output image that is shown at the screen, while all the rendering commands draw to the back buffer.
 		// As soon as all the rendering commands are finished we swap the back buffer to the front buffer so the image can be displayed
 		// without still being rendered to, removing all the aforementioned artifacts.
-		glfwSwapBuffers(window);
+		if (profile)
+		{
+			// The overlay shows the averages of frames a few frames back, the GPU timings of this frame aren't known yet.
+			int overlayWidth = headlessContext.Width, overlayHeight = headlessContext.Height;
+#ifndef PLAYGROUND_HEADLESS_ONLY
+			if (!headless)
+				glfwGetFramebufferSize(window, &overlayWidth, &overlayHeight);
+#endif
+			ProfileScope scope(profiler, "overlay");
+			profilerOverlay.draw(profiler, overlayWidth, overlayHeight);
+		}
+
+		// Fence the data streamed this frame, now that every draw reading it has been issued.
+		// Software drivers like llvmpipe render the queued up draws when a fence is created, so that's where their time goes.
+		if (instanced)
+			instancedRenderer.endFrame();
+		if (profile)
+			profilerOverlay.endFrame();
+		profiler.endFrame();
+
+		if (fixedFrameCount)
+		{
+			recorder.countStateChanges(renderState().Issued, renderState().Skipped);
+			if (instanced)
+			{
+				StreamBuffer& instances = instancedRenderer.Instances;
+				recorder.countStreaming(instances.BytesWritten, instances.Stalls, instances.StallTime);
+				instances.resetCounters();
+			}
+			recorder.endCpuWork();
+		}
+
+		if (headless)
+		{
+			// Without a window there's nothing to swap, instead wait for the frame to finish so we can time it.
+			headlessContext.finishFrame();
+
+			if (golden)
+				golden->check(GoldenSuite::poses()[frame], headlessContext.readPixels(), headlessContext.Width, headlessContext.Height);
+		}
+		else
+		{
+#ifndef PLAYGROUND_HEADLESS_ONLY
+			glfwSwapBuffers(window);
+
+			// Checks if any events are triggered (keyboard input or mouse movement events).
+			glfwPollEvents();
+#endif
+		}
+
+		if (fixedFrameCount)
+			recorder.endFrame();
+
+		frame++;
+	}
+
+	if (fixedFrameCount)
+		recorder.finish();
+
+	if (pipelined)
+	{
+		framePipeline.stop();
+		framePipeline.printStatistics(std::cout);
+	}
+
+	if (profiler.Enabled)
+	{
+		profiler.finish();
+		profiler.printSummary(std::cout);
+		if (tracePath && profiler.writeChromeTrace(tracePath))
+			std::cout << "Wrote " << tracePath << std::endl;
+	}
+
+	// Report the frame timings of the run. The golden image suite only renders a few frames, without warmup, so its timings mean nothing.
+	bool allocationsPassed = true;
+	if (fixedFrameCount && !golden)
+	{
+		recorder.printSummary(std::cout);
+		if (reportPath && recorder.writeReport(reportPath, cameraScript.Name))
+			std::cout << "Wrote " << reportPath << std::endl;
+		if (checkAllocations)
+			allocationsPassed = recorder.checkAllocations();
+	}
+
+	shaderLibrary.destroy();
+	if (profile)
+		profilerOverlay.destroy();
+	textureLoader.destroy();
+
+	if (headless)
+	{
+		// Save the last rendered frame.
+		if (outputPath)
+		{
+			std::vector<unsigned char> pixels = headlessContext.readPixels();
+			if (Image::writePNG(outputPath, headlessContext.Width, headlessContext.Height, 4, pixels.data(), true))
+				std::cout << "Wrote " << outputPath << std::endl;
+		}
 
-		// Checks if any events are triggered (keyboard input or mouse movement events).
-		glfwPollEvents();
+		headlessContext.destroy();
+	}
+	else
+	{
+#ifndef PLAYGROUND_HEADLESS_ONLY
+		// Clean/delete all of GLFW's resources that were allocated.
+		glfwTerminate();
+#endif
 	}
 
-	// Clean/delete all of GLFW's resources that were allocated.
-	glfwTerminate();
+	if (golden && !golden->printSummary(std::cout))
+		return -1;
+	if (!allocationsPassed)
+		return -1;
 
 	return 0;
 }
@@ -474,12 +1029,13 @@ int main()
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	// Set the dimensions of the OpenGL viewport (the size of the rendering window created with GLFW).
-	glViewport(0, 0, width, height);
+	renderState().setViewport(0, 0, width, height);
 }
 
 // Process input on each render iteration in the render loop.
 void processInput(GLFWwindow* window)
 {
+#ifndef PLAYGROUND_HEADLESS_ONLY
 	// If the ESC key is being pressed, tell GLFW to close the window (will exit the render loop).
 	// glfwGetKey will return GLFW_PRESS is the key is currently being pressed, while returning GLFW_RELEASE if it's not.
 	if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -494,6 +1050,7 @@ void processInput(GLFWwindow* window)
 		cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+#endif
 }
 
  // Process mouse movement.
@@ -544,4 +1101,150 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 		fov = 1.0f;
 	if(fov > 90.0f)
 		fov = 90.0f;
-}
\ No newline at end of file
+}
+
+// Append pseudo-random cube positions until there are count positions.
+// The positions are generated from a fixed seed, so every run (and every machine) gets the same scene.
+// The cubes are spread over a volume growing with the cube count, keeping roughly the same density as the 10 hand placed cubes.
+void generateCubePositions(std::vector<glm::vec3>& positions, int count)
+{
+	float extent = 8.0f * cbrt((float)count / 10.0f);
+	unsigned int seed = 12345u;
+	while ((int)positions.size() < count)
+	{
+		glm::vec3 position;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// Linear congruential generator, good enough for scattering cubes.
+			seed = seed * 1664525u + 1013904223u;
+			position[axis] = ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * extent;
+		}
+		position.z -= extent;
+		positions.push_back(position);
+	}
+}
+
+// The model matrix defines the transform properties of the object.
+// The matrix consists of: location (translate) rotation, and scale.
+// Every cube is rotated around the same axis, by 20 degrees more than the one before it.
+void addCubeTransforms(TransformSystem& transforms, const std::vector<glm::vec3>& positions)
+{
+	const glm::vec3 axis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+	transforms.reserve(positions.size());
+	for (unsigned int i = 0; i < positions.size(); i++)
+	{
+		// Model translation defines the objects world location.
+		float angle = 20.0f * i;
+		transforms.add(positions[i], glm::angleAxis(glm::radians(angle), axis));
+	}
+}
+
+// The camera as moved by keyboard and mouse.
+CameraPose currentCameraPose()
+{
+	CameraPose pose;
+	pose.Position = cameraPos;
+	pose.Front = cameraFront;
+	pose.FOV = fov;
+	return pose;
+}
+
+// Tell OpenGL which texture unit each shader sampler belongs to.
+// Uniform values are part of the program object, so this has to happen again whenever a shader is reloaded.
+void setShaderUniforms(Shader& shader, Shader& instancedShader, Uniform<glm::mat4>& modelUniform)
+{
+	instancedShader.use();
+	instancedShader.setInt("texture1", 0);
+	instancedShader.setInt("texture2", 1);
+
+	shader.use();
+	shader.setInt("texture1", 0);
+	shader.setInt("texture2", 1);
+
+	// Look up the uniforms we set every frame once, instead of searching for them by name on every call.
+	modelUniform = shader.getUniform<glm::mat4>("model");
+}
+
+// Render the cube scene with the software rasterizer, in the same way the OpenGL path renders it in headless mode.
+int renderSoftware(int frameCount, int warmupFrames, const char* benchmarkScript, const char* outputPath, const char* reportPath,
+	int cubeCount, bool cull, int threadCount, GoldenSuite* golden)
+{
+	// The same images as the OpenGL textures, decoded into CPU memory.
+	stbi_set_flip_vertically_on_load(true);
+	SoftwareTexture texture1, texture2;
+	texture1.load("container.jpg");
+	texture2.load("awesomeface.png");
+
+	SoftwareRasterizer rasterizer(golden ? GoldenSuite::Width : SCR_WIDTH, golden ? GoldenSuite::Height : SCR_HEIGHT, threadCount);
+	rasterizer.setTextures(&texture1, &texture2);
+	std::cout << "Software rasterizer: " << rasterizer.threadCount() << " threads, "
+		<< SoftwareRasterizer::TileSize << "x" << SoftwareRasterizer::TileSize << " pixel tiles" << std::endl;
+
+	std::vector<glm::vec3> cubePositions(initialCubePositions, initialCubePositions + 10);
+	generateCubePositions(cubePositions, cubeCount);
+
+	TransformSystem cubeTransforms;
+	addCubeTransforms(cubeTransforms, cubePositions);
+	cubeTransforms.update();
+
+	std::vector<unsigned int> drawList;
+	BoundingSpheres cubeBounds;
+	FrustumCuller culler;
+	for (unsigned int i = 0; i < cubePositions.size(); i++)
+	{
+		if (cull)
+			cubeBounds.push_back(cubePositions[i], 0.8660254f);
+		else
+			drawList.push_back(i);
+	}
+
+	// There's no GPU work to time, everything happens before endCpuWork().
+	CameraScript cameraScript(benchmarkScript ? benchmarkScript : "static");
+	BenchmarkRecorder recorder(warmupFrames, false);
+	recorder.Renderer = "software";
+	recorder.reserve(frameCount);
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		recorder.beginFrame();
+
+		CameraPose pose = golden ? GoldenSuite::evaluate(GoldenSuite::poses()[frame]) : cameraScript.evaluate(frame);
+		glm::mat4 view = glm::lookAt(pose.Position, pose.Position + pose.Front, cameraUp);
+		glm::mat4 projection = glm::perspective(glm::radians(pose.FOV), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 viewProjection = projection * view;
+
+		if (cull)
+		{
+			culler.cull(Frustum::fromMatrix(viewProjection), cubeBounds, drawList);
+			recorder.countCulling(culler.Visible, culler.Culled);
+		}
+
+		rasterizer.beginFrame(glm::vec4(0.f, 0.3f, 0.3f, 1.0f));
+		for (unsigned int i = 0; i < drawList.size(); i++)
+			rasterizer.draw(cubeVertices, 36, 5, viewProjection * cubeTransforms.Matrices[drawList[i]]);
+		rasterizer.endFrame();
+		recorder.countDrawCalls((int)drawList.size());
+
+		recorder.endCpuWork();
+		recorder.endFrame();
+
+		if (golden)
+			golden->check(GoldenSuite::poses()[frame], rasterizer.Color, rasterizer.Width, rasterizer.Height);
+	}
+
+	recorder.finish();
+	if (!golden)
+	{
+		recorder.printSummary(std::cout);
+		if (reportPath && recorder.writeReport(reportPath, cameraScript.Name))
+			std::cout << "Wrote " << reportPath << std::endl;
+	}
+
+	if (outputPath && Image::writePNG(outputPath, rasterizer.Width, rasterizer.Height, 4, rasterizer.Color.data(), true))
+		std::cout << "Wrote " << outputPath << std::endl;
+
+	if (golden && !golden->printSummary(std::cout))
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec4 Color;
+
+// Single channel font texture: 1 where a glyph has a pixel.
+uniform sampler2D font;
+
+void main()
+{
+	FragColor = vec4(Color.rgb, Color.a * texture(font, TexCoord).r);
+}
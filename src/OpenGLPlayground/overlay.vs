@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColor;
+
+out vec2 TexCoord;
+out vec4 Color;
+
+// Size of the framebuffer in pixels (x and y), the overlay's positions are in pixels from the top left corner.
+uniform vec4 screenSize;
+
+void main()
+{
+	gl_Position = vec4(aPos.x / screenSize.x * 2.0 - 1.0, 1.0 - aPos.y / screenSize.y * 2.0, 0.0, 1.0);
+	TexCoord = aTexCoord;
+	Color = aColor;
+}
@@ -5,11 +5,19 @@ layout (location = 1) in vec2 aTexCoord;
 out vec2 TexCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Per-frame data shared by all shaders, written once per frame (see UniformBuffer.h).
+layout (std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec3 cameraPosition;
+	float time;
+};
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = viewProjection * model * vec4(aPos, 1.0f);
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file